@@ -1,3 +1,6 @@
+#define _GNU_SOURCE
+// Build: gcc -O2 -pthread Uno.c -o uno -lm
+// Add -DUNO_TELEMETRY for the engine counters and latency histograms (--telemetry)
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -5,8 +8,103 @@
 #include <stdbool.h>
 #include <signal.h>
 #include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <strings.h>
+#include <math.h>
+#include <stdarg.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 
+#define DECK_SIZE 108
+#define NUM_CARD_IDS 54                 // 13 colored types in 4 colors, plus Wild and Wild Draw Four
+#define CARDS_PER_PLAYER 7
+#define MAX_COPIES 4                    // most copies of one card id in the deck
+#define MAX_PLAYERS 10                  // most seats of a table that is saved, solved, served or simulated
+#define PLAYERS_PER_DECK 10             // larger tables shuffle one more deck per ten players
+#define MAX_DECKS 63                    // most decks in a game, so a hand holds at most 252 copies of a card
+#define MAX_MOVES (4 * DECK_SIZE + 1)   // every card as a wild in four colors, plus draw
+#define MAX_TURNS 10000                 // simulated games stop here without a winner
+#define SIMULATION_CHUNK 256            // games a simulation worker claims at a time
+#define BATCH_SIZE 256                  // games the batch engine steps in lockstep
+#define SHUFFLE_LANES 16                // decks the batch shuffle kernel shuffles together
+#define MAX_ENTRANTS 8                  // strategies in one tournament
+#define MAX_PAIRINGS (MAX_ENTRANTS * (MAX_ENTRANTS - 1) / 2)
+#define TOURNAMENT_CHUNK 64             // games a tournament worker claims at a time
+#define TOURNAMENT_MIN_GAMES 200        // games per pairing before the ranking may be called settled
+#define NO_CARD 0xFF
+
+// House rules, combined into one rule set per table. Every rule set gets its own copy of the
+// turn engine, specialized at compile time, so a table pays nothing for the rules it does not use.
+#define RULE_STACKING 1                 // Draw Two and Wild Draw Four stack onto the pending draw
+#define RULE_SEVEN_ZERO 2               // A 7 swaps hands with the smallest other hand, a 0 passes all hands on
+#define RULE_JUMP_IN 4                  // A player holding the exact card just played plays it out of turn
+#define RULE_DRAW_UNTIL_PLAYABLE 8      // A draw goes on until a playable card comes
+#define RULE_FORCED_PLAY 16             // A player who can play must play, a playable drawn card too
+#define NUM_RULES 5
+#define NUM_RULE_SETS (1 << NUM_RULES)
+#define INPUT_BUFFER_SIZE (1 << 16)     // bytes of input read at once
+#define MAX_TOKEN_LENGTH 63             // longest command word read, longer tokens are cut (names are read whole)
+#define KEYWORD_TABLE_SIZE 64           // slots of the keyword hash table, a power of two
+#define SNAPSHOT_VERSION 3
+#define SNAPSHOT_MAX_NAME 255           // longer names are cut in snapshots and logs
+#define SNAPSHOT_MAX_SIZE (64 + DECK_SIZE + MAX_PLAYERS * (11 + SNAPSHOT_MAX_NAME)) // largest snapshot
+#define SAVE_FILE "uno.sav"
+
+// Replay log records: actions take one byte, with the card id or color in the low bits
+#define LOG_PLAY 0x80               // | card id played
+#define LOG_DRAW 0x40               // | card id drawn, LOG_NO_CARD when nothing was left to draw
+#define LOG_COLOR 0x20              // | color chosen for the Wild played just before
+#define LOG_PASS 0x10               // drawn card kept
+#define LOG_GAME 0x11               // seed (8 bytes), player count, name length and name per player
+#define LOG_CHECKPOINT 0x12         // turn (4 bytes), snapshot size (2 bytes), snapshot
+#define LOG_END 0x13                // winner seat (0xFF for none), turns (4 bytes), then the game index
+#define LOG_NO_CARD 0x3F
+#define LOG_VERSION 4
+#define LOG_CHECKPOINT_INTERVAL 32  // turns between two checkpoints of a logged game
+#define LOG_BUFFER_SIZE (1 << 20)
+#define EVENT_RING_SIZE 4096            // events a consumer may fall behind by at one table, a power of two
+#define EVENT_MAX_CONSUMERS 4           // consumers listening to one table
+#define EVENT_IDLE_NS 200000            // time a consumer sleeps when no table has events for it
+#define SEARCH_PLAYOUTS 20000           // default playouts per decision of a search bot
+#define SEARCH_PLAYOUT_TURNS 1000       // playouts stop here without a winner
+#define SEARCH_EXPLORATION 0.7          // UCB exploration constant, rewards are 0 or 1
+#define SEARCH_CLOCK_INTERVAL 64        // playouts between two looks at the clock
+#define BELIEF_WEIGHT 16                // weight of a card id a hidden card may be
+#define BELIEF_DOUBT 2                  // weight of a card id a player seemed to lack, drawing instead of playing it
+#define SOLVER_MAX_PLIES 64             // deepest search of the endgame solver
+#define SOLVER_MAX_LINE (4 * SOLVER_MAX_PLIES) // longest line searched, forced moves included
+#define SOLVER_DEFAULT_PLIES 40         // plies searched by --solve unless told otherwise
+#define SOLVER_DEFAULT_NODES 10000000   // positions searched by --solve for each goal unless told otherwise
+#define SOLVER_TABLE_BITS 20            // the solver's transposition table holds 2^20 entries
+#define SOLVER_INFINITY ((1u << 24) - 1) // proof number of a position that cannot be proven
+#define SOLVER_UNKNOWN (SOLVER_INFINITY + 1) // proof number of a position not looked up yet
+#define SOLVER_POLL_INTERVAL 1024       // positions a solver thread searches between two looks at the stop flag
+#define BENCH_MIN_TIME 0.2              // seconds a benchmark runs for at least
+#define SOLVER_BENCH_POSITIONS 32       // endgames the solver benchmark solves
+#define RENDER_BUFFER_SIZE 4096         // initial size of the render buffer, it grows as needed
+#define SERVER_LINE_SIZE 4096           // longest line a connection may send
+#define SERVER_MAX_EVENTS 256           // events handled per epoll_wait
+#define SERVER_BACKLOG 4096
+#define SERVER_TABLE_BUCKETS 4096       // hash buckets of the tables of one event loop
+
 
 // Define card colors
 enum Color {
@@ -22,60 +120,654 @@ enum Type {
     ZERO, ONE, TWO, THREE, FOUR, FIVE, SIX, SEVEN, EIGHT, NINE, SKIP, REVERSE, DRAW_TWO, WILD, WILD_DRAW
 };
 
-// Define a card structure
+// Define a card structure (the face of a card, piles and hands store card ids)
 struct Card {
     enum Color color;
     enum Type type;
-    struct Card* next; // Pointer to the next card in the linked list
+};
+
+// Define the state of a random number generator (xoshiro256**)
+struct Rng {
+    unsigned long long s[4];
+};
+
+// Define the decks shuffled together by the batch shuffle kernel, each with its own generator. The
+// generators are kept one word per array, so that a vector holds the same word of several of them.
+struct ShuffleLanes {
+    unsigned long long s[4][SHUFFLE_LANES] __attribute__((aligned(64)));
+    unsigned char* cards[SHUFFLE_LANES]; // Cards of each deck
+    int numLanes;                        // Decks in use, the generators of the other lanes are ignored
+};
+
+// Define a pile of cards (draw pile or discard pile) as a contiguous array. The discard pile keeps its
+// top card last; the draw pile is kept in no particular order, cards are picked from it at random.
+struct Deck {
+    unsigned char* cards;           // Card ids, see makeCard
+    int count;                      // Number of cards in the pile
+};
+
+// Define a hand as the number of copies held of each card id
+struct Hand {
+    unsigned char counts[NUM_CARD_IDS]; // Copies held of each card id
+    unsigned long long mask;            // Bit set for every card id held at least once
+    int size;                           // Number of cards in the hand
+    // What the other players can tell from the draws (see inferDraw). The evidence moves with the
+    // cards when hands are swapped or passed on.
+    unsigned long long excluded;        // Card ids the oldest cards of the hand are believed not to be
+    int constrained;                    // Number of those oldest cards
 };
 
 // Define a player structure
 struct Player {
-    char name[20];           // Name of the player
-    struct Card* hand;       // Circular linked list representing the player's hand
-    struct Player* prev;     // Pointer to the previous player in the doubly linked list
-    struct Player* next;     // Pointer to the next player in the doubly linked list
+    char* name;              // Name of the player, in the block of the game
+    int seat;                // Position of the player at the table, starting at 0
+    struct Hand hand;        // Cards held by the player
+    struct Strategy* strategy; // How a bot picks its moves, NULL for a human at the keyboard
+};
+
+// Define the kinds of move a player can make
+enum MoveKind {
+    MOVE_PLAY,   // Play a card from the hand
+    MOVE_DRAW,   // Draw a card from the deck
+    MOVE_PASS    // Keep the card that was just drawn and end the turn
+};
+
+// Define a move structure
+struct Move {
+    enum MoveKind kind;
+    unsigned char card;      // Card id to play (MOVE_PLAY only)
+    enum Color color;        // Color chosen for a Wild or Wild Draw Four
+};
+
+// Define how game output reaches the terminal
+enum RenderMode {
+    RENDER_PLAIN,        // Text written once per turn, as it was rendered
+    RENDER_QUIET,        // Nothing is formatted nor written
+    RENDER_ANSI          // The screen is redrawn each turn, rewriting only the lines that changed
+};
+
+// Define the buffer all game output goes through
+struct RenderBuffer {
+    enum RenderMode mode;
+    char* text;              // Text rendered since the last flush, or since the frame began (ANSI)
+    size_t used;
+    size_t capacity;
+    char* screen;            // ANSI: text of the frame on the screen, NULL when the screen is unknown
+    size_t screenSize;
+    int screenLines;         // ANSI: lines of that frame, input was typed on the last one
+};
+
+// Define the kinds of player
+enum StrategyKind {
+    STRATEGY_HUMAN,      // Types moves at the keyboard
+    STRATEGY_SCRIPTED,   // Plays the first legal card (chooseScriptedMove)
+    STRATEGY_RANDOM,     // Plays a legal move at random
+    STRATEGY_GREEDY,     // Scores every legal move with a few rules of thumb
+    STRATEGY_SEARCH      // Information-set Monte Carlo tree search
+};
+
+// Define the budget of a search bot for one decision
+struct SearchBudget {
+    long playouts;           // Playouts per decision, 0 for no limit
+    double seconds;          // Thinking time per decision, 0 for no limit
+    int threads;             // Threads searching in parallel, one tree each
+};
+
+// Define what the endgame solver found, seen from the player to move
+struct SolveResult {
+    int value;               // 1 for a forced win, -1 for a forced loss, 0 if neither shows within the ply limit
+    struct Move move;        // Winning move, or else the move closest to a win; a pass of NO_CARD once the game is over
+    bool complete;           // Both searches ran to the end, no forced result shows within the ply limit
+    long nodes;              // Positions searched by all threads
+    double seconds;          // Time spent solving
+};
+
+// Define a per-game arena: one block that owns the game state, its cards and its players
+struct Arena {
+    unsigned char* block;    // Memory owned by the arena
+    size_t capacity;         // Size of the block
+    size_t used;             // Bytes handed out so far
+};
+
+// Define the allocation counters shared by all arenas
+struct AllocCounters {
+    long blocksAllocated;    // Arena blocks taken from malloc
+    long blocksReleased;     // Arena blocks given back to free
+    long bytesInUse;         // Bytes held by arenas that were not released yet
+};
+
+#ifdef UNO_TELEMETRY
+// Define the engine events that are counted. Search playouts go through the same engine,
+// so their events are counted too.
+enum TelemetryCounter {
+    TELEMETRY_GAMES,             // Games finished or stopped
+    TELEMETRY_TURNS,             // Turns played in those games
+    TELEMETRY_CARDS_DRAWN,       // Cards drawn, including penalties
+    TELEMETRY_RESHUFFLES,        // Discard pile put back into the deck
+    TELEMETRY_SKIPS,             // Turns skipped by Skip, Draw Two and Wild Draw Four
+    TELEMETRY_REVERSES,
+    TELEMETRY_DRAW_TWOS,
+    TELEMETRY_WILD_DRAWS,
+    TELEMETRY_NUM_COUNTERS
+};
+
+// Define the measured distributions, each kept as a log2 histogram
+enum TelemetryHistogram {
+    TELEMETRY_TURNS_PER_GAME,
+    TELEMETRY_TURN_NS,           // Time to pick and apply one move in the turn loop
+    TELEMETRY_MOVEGEN_NS,        // Time in listLegalMoves from the turn loop
+    TELEMETRY_NUM_HISTOGRAMS
+};
+
+#define TELEMETRY_BUCKETS 65     // bucket b counts values below 2^b and at least 2^(b-1)
+
+// Define the telemetry of one thread
+struct Telemetry {
+    unsigned long long counters[TELEMETRY_NUM_COUNTERS];
+    unsigned long long buckets[TELEMETRY_NUM_HISTOGRAMS][TELEMETRY_BUCKETS];
+    unsigned long long sums[TELEMETRY_NUM_HISTOGRAMS];
+};
+#endif
+
+// Define the totals of a batch of simulated games
+struct SimStats {
+    long games;
+    long turns;
+    long unfinished;                     // Games stopped at MAX_TURNS
+    long wins[MAX_PLAYERS];              // Games won from each seat
+    long playouts;                       // Playouts run by search bots
+    struct AllocCounters alloc;          // Arena counters of the thread that played them
+#ifdef UNO_TELEMETRY
+    struct Telemetry telemetry;          // Telemetry of the thread that played them
+#endif
+};
+
+// Define the shared writer of a replay log file, finished games are appended to it whole
+struct LogWriter {
+    FILE* file;
+    unsigned char* buffer;       // Bytes not written to the file yet
+    size_t used;
+    pthread_mutex_t lock;        // Simulation threads append games concurrently
+};
+
+// Define the records of a game being logged
+struct GameLog {
+    struct LogWriter* writer;
+    unsigned char* bytes;        // Records of the game so far
+    size_t used;
+    size_t capacity;
+    unsigned int* checkpoints;   // Turn and offset in bytes of every checkpoint record
+    int numCheckpoints;
+    int checkpointCapacity;
+};
+
+// Define the kinds of event a game publishes
+enum GameEventKind {
+    EVENT_CARD_PLAYED,
+    EVENT_CARD_DRAWN,            // One per card, penalties included
+    EVENT_COLOR_CHOSEN,          // For the Wild just played
+    EVENT_DIRECTION_CHANGED,
+    EVENT_GAME_WON,
+    EVENT_NUM_KINDS
+};
+
+// Define an event of a game
+struct GameEvent {
+    unsigned char kind;          // enum GameEventKind
+    unsigned char card;          // Card played or drawn, NO_CARD for the other events
+    unsigned char color;         // Color chosen, SPECIAL for the other events
+    signed char direction;       // Direction of play after the event
+    int seat;                    // Player the event is about
+    int turn;                    // Turns completed when it happened
+    unsigned int game;           // Number of the game at its table
+};
+
+// Define a ring buffer of events from one table to one consumer. Only the game loop of the table
+// writes head and only the consumer writes tail, so neither ever waits for the other: an event that
+// finds the ring full is dropped and counted.
+struct EventRing {
+    _Alignas(64) atomic_ulong head;          // Events published
+    unsigned long tailSeen;                  // Last tail the producer read
+    atomic_ulong dropped;                    // Events the ring had no room for
+    _Alignas(64) atomic_ulong tail;          // Events consumed
+    unsigned long headSeen;                  // Last head the consumer read
+    struct GameEvent events[EVENT_RING_SIZE];
+};
+
+// Define what a table publishes its events to: one ring per consumer
+struct EventBus {
+    struct EventRing* rings[EVENT_MAX_CONSUMERS];
+    int numRings;
+    unsigned int game;                       // Games finished at the table
+};
+
+// Define a consumer of the events of every table, on a thread of its own
+struct EventConsumer {
+    pthread_t thread;
+    const char* name;
+    void (*handle)(struct EventConsumer* consumer, int table, const struct GameEvent* event);
+    struct EventRing* rings;     // Its ring at each table
+    int numTables;
+    atomic_bool stop;            // Set once no table publishes anymore
+    long handled;                // Events taken from the rings
+    FILE* file;                  // Logger: where the events are written
+    long counts[EVENT_NUM_KINDS]; // Statistics: events of each kind
+};
+
+// Define the consumers listening to the tables of a session
+struct EventListeners {
+    struct EventConsumer consumers[2]; // Logger and statistics
+    int numConsumers;
+    struct EventBus* buses;      // One per table
+    int numTables;
+};
+
+// Define the kinds of change a move makes to the cards, recorded so that the move can be undone
+enum ChangeKind {
+    CHANGE_DRAW,                 // A card went from the deck to a hand
+    CHANGE_RECYCLE,              // The discard pile was put back into the deck, but for its top card
+    CHANGE_PLAY,                 // A card went from a hand to the discard pile
+    CHANGE_EVIDENCE,             // A draw told the others something about a hand (see inferDraw)
+    CHANGE_SWAP,                 // Two hands were swapped (7-0 rule)
+    CHANGE_PASS                  // Every hand passed on to the next player (7-0 rule)
+};
+
+// Define one change to the cards
+struct Change {
+    unsigned char kind;          // enum ChangeKind
+    unsigned char card;          // Card drawn or played, or the top card kept by a recycle
+    unsigned short seat;         // Player whose hand changed
+    int slot;                    // Place of a drawn card in the deck, the other seat of a swap, or the
+                                 // number of seats the hands passed by
+    int constrained;             // Evidence about the hand before the change
+    unsigned long long excluded;
+};
+
+// Define the journal of the changes made by the moves that can still be undone
+struct UndoLog {
+    struct Change* changes;
+    int numChanges;
+    int capacity;
+};
+
+// Define what undoes a move besides its changes to the cards: the rest of the state before it
+struct Undo {
+    struct Rng rng;              // Generator before the move, which takes back every random pick
+    int firstChange;             // First change of the move in the undo log
+    int currentSeat;
+    int direction;
+    int drawnCard;
+    int winnerSeat;              // -1 while the game was running
+    int turns;
+    int pendingDraw;
+    enum Color activeColor;
+};
+
+// Define the state of a game
+struct Game {
+    struct Arena arena;            // Block holding this game, its piles and its players
+    struct Rng rng;                // Random numbers for this game only
+    struct Deck piles[2];          // Storage of the two piles, which swap roles when the deck runs out
+    struct Deck* deck;             // Draw pile
+    struct Deck* discardPile;      // Discard pile
+    enum Color activeColor;        // Color to match, the chosen color when a Wild is on top
+    unsigned char discardCounts[NUM_CARD_IDS]; // Copies of each card id in the discard pile
+    struct Player* seats;          // Players by seat number, play goes around them by index
+    int direction;                 // 1 while play goes in seat order, -1 after an odd number of Reverses
+    struct Player* currentPlayer;  // Player whose turn it is
+    int drawnCard;                 // Playable card id drawn this turn, -1 otherwise
+    struct Player* winner;         // Player who emptied their hand, NULL while the game runs
+    int numPlayers;
+    int turns;                     // Number of completed turns
+    unsigned int rules;            // House rules of the table, RULE_* bits
+    int pendingDraw;               // Cards the current player draws unless they stack (RULE_STACKING)
+    bool verbose;                  // Print what happens (interactive games)
+    struct GameLog* log;           // Replay log being written, NULL when not logging
+    struct UndoLog* undoLog;       // Journal of the move being made by makeMove, NULL otherwise
+    struct EventBus* events;       // Where the events of the game go, NULL when nobody listens
+};
+
+// Define a player strategy: a bot picks one of the legal moves of the current player
+struct Strategy {
+    enum StrategyKind kind;
+    struct Move (*chooseMove)(struct Strategy* strategy, struct Game* game, struct Move* moves, int numMoves);
+    struct Rng rng;                // Random numbers of this bot only
+    struct SearchBudget budget;    // Search bots only
+    long playouts;                 // Playouts run by all searches so far
+    double searchTime;             // Seconds spent searching so far
 };
 
 
 
-struct Card* createCard(enum Color color, enum Type type);
-void addCardToDeck(struct Card** deck, struct Card* newCard);
-void initializeDeck(struct Card** deck);
-void shuffleDeck(struct Card** deck);
+
+unsigned char makeCard(enum Color color, enum Type type);
+enum Color cardColor(unsigned char card);
+enum Type cardType(unsigned char card);
+void initializeDeck(struct Deck* deck, int numDecks);
+void shuffleDeck(struct Deck* deck, struct Rng* rng);
+void shuffleLanes(struct ShuffleLanes* lanes, int count, int steps);
+void shuffleDecks(struct Deck* decks, struct Rng* rngs, int numDecks);
+void rngSeed(struct Rng* rng, unsigned long long seed);
+unsigned long long rngNext(struct Rng* rng);
+unsigned int rngBounded(struct Rng* rng, unsigned int bound);
+void rngJump(struct Rng* rng);
+void rngSplit(struct Rng* rng, struct Rng* child);
 const char* getColorName(enum Color color);
 const char* getTypeName(enum Type type);
 void printCard(struct Card* card);
+void setRenderMode(enum RenderMode mode);
+void renderf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void renderFlush();
+void renderNewFrame();
+void renderReset();
 
-struct Player* createPlayer(const char* name);
-void addPlayerToList(struct Player** firstPlayer, struct Player* newPlayer);
-void dealCard(struct Card** deck, struct Player* player);
-void dealCards(struct Card** deck, struct Player* firstPlayer, int numPlayers, int numCardsPerPlayer);
+void arenaInit(struct Arena* arena, size_t capacity);
+void* arenaAlloc(struct Arena* arena, size_t size);
+void arenaRelease(struct Arena* arena);
+
+void initPlayer(struct Arena* arena, struct Player* player, const char* name, int seat);
+unsigned char dealCard(struct Deck* deck, struct Rng* rng, struct Player* player);
+void dealCards(struct Deck* deck, struct Rng* rng, struct Player* players, int numPlayers, int numCardsPerPlayer);
 void displayHand(struct Player* player);
-void removeCardFromHand(struct Player* player, struct Card* cardToRemove);
+void addCardToHand(struct Hand* hand, unsigned char card);
+void removeCardFromHand(struct Player* player, unsigned char cardToRemove);
 int checkValidMove(struct Card* topCard, struct Card* playedCard);
-void displayLastCard(struct Player* player);
-void freePlayer(struct Player* player) ;
-void freePlayerList(struct Player* firstPlayer) ;
-
-
-void SkipTurn(struct Player** currentPlayer);
-void Wild(struct Card* card);
-void Draw_Two(struct Card** deck, struct Player* nextplayer);
-void WildDraw(struct Card** deck, struct Player* nextplayer, struct Card* currentcard);
-void reverseDirection(struct Player* firstPlayer);
-void printPlayerList(struct Player* firstPlayer);
-void playTurn(struct Card** deck, struct Player** currentPlayer, struct Card** discardPile);
-void playGame();
+unsigned long long legalMoveMask(unsigned long long hand, unsigned char topCard, enum Color activeColor);
+void legalMoveMasks(const unsigned long long* hands, const unsigned char* topCards,
+                    const unsigned char* activeColors, unsigned long long* masks, int count);
+void displayLastCard(unsigned char card);
+
+struct Game* createGame(const char* names[], int numPlayers, bool verbose, unsigned long long seed);
+int listLegalMoves(struct Game* game, struct Move* moves);
+void applyMove(struct Game* game, const struct Move* move);
+void initUndoLog(struct UndoLog* log);
+void freeUndoLog(struct UndoLog* log);
+void makeMove(struct Game* game, const struct Move* move, struct UndoLog* log, struct Undo* undo);
+void unmakeMove(struct Game* game, struct UndoLog* log, const struct Undo* undo);
+bool parseRules(const char* list, unsigned int* rules);
+struct Player* getWinner(struct Game* game);
+void freeGame(struct Game* game);
+struct Game* cloneGame(const struct Game* game);
+void copyGame(struct Game* copy, const struct Game* game);
+void determinize(struct Game* game, int observer, struct Rng* rng);
+double holdProbability(const struct Game* game, int observer, int seat, unsigned long long cards);
+size_t saveGame(const struct Game* game, unsigned char* buffer, size_t capacity);
+struct Game* loadGame(const unsigned char* buffer, size_t size, bool verbose);
+bool saveGameToFile(const struct Game* game, const char* path);
+struct Game* loadGameFromFile(const char* path, bool verbose);
+
+struct LogWriter* openLogWriter(const char* path);
+void closeLogWriter(struct LogWriter* writer);
+void initGameLog(struct GameLog* log, struct LogWriter* writer);
+void freeGameLog(struct GameLog* log);
+void beginGameLog(struct GameLog* log, struct Game* game, unsigned long long seed);
+void endGameLog(struct Game* game);
+struct EventListeners* startEventListeners(const char* path, int numTables);
+void stopEventListeners(struct EventListeners* listeners);
+int replayLog(const char* path, long gameNumber, long turn);
+
+void SkipTurn(struct Game* game);
+enum Color Wild();
+void Draw_Two(struct Game* game, struct Player* nextplayer);
+void WildDraw(struct Game* game, struct Player* nextplayer);
+void reverseDirection(struct Game* game);
+void playTurn(struct Game* game);
+bool openScriptInput(const char* path);
+bool readChoice(int* choice);
+void playGame(unsigned long long seed, unsigned int rules);
+void resumeGame();
+void runGame(struct Game* game, unsigned long long seed);
+struct Move chooseScriptedMove(struct Game* game, struct Move* moves, int numMoves);
+bool parseStrategyKind(const char* text, enum StrategyKind* kind);
+void initStrategy(struct Strategy* strategy, enum StrategyKind kind, unsigned long long seed,
+                  const struct SearchBudget* budget);
+void playBotTurn(struct Game* game);
+int solveEndgame(const struct Game* game, int maxPlies, long maxNodes, int numThreads, struct SolveResult* result);
+int runSolver(const char* path, int maxPlies, long maxNodes, int numThreads);
+void simulateGames(long numGames, int numPlayers, const enum StrategyKind* kinds, unsigned int rules,
+                   int numThreads, unsigned long long masterSeed, struct LogWriter* writer, bool batched);
+void runBenchmarks();
+int runServer(const char* address, int numLoops, unsigned long long seed, unsigned int rules);
+int runTournament(const char* list, long maxGames, int numThreads, unsigned long long seed, unsigned int rules);
+int runLoadTest(const char* address, int numConnections, int numPlayers, int numGames);
+#ifdef UNO_TELEMETRY
+void printThreadTelemetry(const char* format);
+#endif
 void displayInstructions();
 void displayCredits();
 
 
-int main() {
+// Replay log shared by the games of an interactive session, NULL when not logging
+static struct LogWriter* sessionLog = NULL;
+
+// Consumers of the events of the games of the session, NULL when nobody listens
+static struct EventListeners* sessionEvents = NULL;
+
+// Format to dump the telemetry in at the end ("json" or "prometheus"), NULL for none
+static const char* telemetryFormat = NULL;
+
+// Budget of the search bots, set from the command line
+static struct SearchBudget searchBudget = { SEARCH_PLAYOUTS, 0, 0 };
+
+int main(int argc, char* argv[]) {
     int choice;
 
-    // Seed for random number generation
-    srand(time(NULL));
+    // Batch simulation mode: uno --simulate N [--players P] [--threads T] [--seed S] [--log FILE]
+    //                       [--bots KIND,KIND,...] [--batch]
+    // Benchmarks (JSON on stdout): uno --bench
+    // Server: uno --serve [HOST:]PORT|PATH [--loops L] [--seed S]
+    // Load test: uno --loadtest [HOST:]PORT|PATH [--connections N] [--players P] [--games G]
+    // Search bot budget: [--playouts N] [--think-ms M] [--search-threads T]
+    // Replay tool: uno --replay FILE [--game G] [--turn K]
+    // Event stream of simulated and interactive games, one JSON line per event: [--events FILE]
+    // Scripted input: uno --script FILE|- [--seed S] [--quiet] reads the whole session from FILE
+    // House rules of simulated, interactive and served games: [--rules RULE,...]
+    // Tournament: uno --tournament KIND,KIND,... [--max-games N] [--threads T] [--seed S]
+    // Endgame solver: uno --solve FILE [--plies N] [--nodes N] [--threads T] solves a saved game
+    unsigned long long seed = (unsigned long long)time(NULL);
+    const char* logPath = NULL;
+    const char* eventsPath = NULL;
+    const char* replayPath = NULL;
+    long replayGame = -1;
+    long replayTurn = -1;
+    long numGames = 0;
+    int numPlayers = 4;
+    int numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    enum StrategyKind kinds[MAX_PLAYERS];
+    const char* botList = NULL;
+    const char* serveAddress = NULL;
+    const char* loadTestAddress = NULL;
+    int numLoops = 0;
+    int numConnections = 1000;
+    int numRounds = 10;
+    bool batched = false;
+    const char* scriptPath = NULL;
+    unsigned int rules = 0;
+    const char* tournamentList = NULL;
+    long maxGames = 100000;
+    const char* solvePath = NULL;
+    int maxPlies = SOLVER_DEFAULT_PLIES;
+    long maxNodes = SOLVER_DEFAULT_NODES;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--simulate") == 0 && i + 1 < argc) {
+            numGames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--players") == 0 && i + 1 < argc) {
+            numPlayers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            numThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            logPath = argv[++i];
+        } else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            eventsPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--game") == 0 && i + 1 < argc) {
+            replayGame = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--turn") == 0 && i + 1 < argc) {
+            replayTurn = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            runBenchmarks();
+            return 0;
+        } else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            telemetryFormat = argv[++i];
+#ifndef UNO_TELEMETRY
+            fprintf(stderr, "Telemetry needs a build with -DUNO_TELEMETRY.\n");
+            return 1;
+#endif
+            if (strcmp(telemetryFormat, "json") != 0 && strcmp(telemetryFormat, "prometheus") != 0) {
+                fprintf(stderr, "Telemetry format must be json or prometheus.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serveAddress = argv[++i];
+        } else if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc) {
+            numLoops = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--loadtest") == 0 && i + 1 < argc) {
+            loadTestAddress = argv[++i];
+        } else if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc) {
+            numConnections = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            numRounds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            scriptPath = argv[++i];
+        } else if (strcmp(argv[i], "--rules") == 0 && i + 1 < argc) {
+            if (!parseRules(argv[++i], &rules)) {
+                fprintf(stderr, "Unknown house rules %s.\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--tournament") == 0 && i + 1 < argc) {
+            tournamentList = argv[++i];
+        } else if (strcmp(argv[i], "--solve") == 0 && i + 1 < argc) {
+            solvePath = argv[++i];
+        } else if (strcmp(argv[i], "--plies") == 0 && i + 1 < argc) {
+            maxPlies = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc) {
+            maxNodes = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--max-games") == 0 && i + 1 < argc) {
+            maxGames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batched = true;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            setRenderMode(RENDER_QUIET);
+        } else if (strcmp(argv[i], "--ansi") == 0) {
+            setRenderMode(RENDER_ANSI);
+        } else if (strcmp(argv[i], "--bots") == 0 && i + 1 < argc) {
+            botList = argv[++i];
+        } else if (strcmp(argv[i], "--playouts") == 0 && i + 1 < argc) {
+            searchBudget.playouts = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--think-ms") == 0 && i + 1 < argc) {
+            searchBudget.seconds = atol(argv[++i]) / 1000.0;
+        } else if (strcmp(argv[i], "--search-threads") == 0 && i + 1 < argc) {
+            searchBudget.threads = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--simulate N [--batch]] [--players P] [--threads T] [--seed S] [--log FILE] [--events FILE]\n"
+                            "          [--bots KIND,KIND,...] [--playouts N] [--think-ms M] [--search-threads T]\n"
+                            "          [--telemetry json|prometheus] [--quiet | --ansi] [--script FILE|-] [--rules RULE,...]\n"
+                            "       %s --replay FILE [--game G] [--turn K]\n"
+                            "       %s --tournament KIND,KIND,... [--max-games N] [--threads T] [--seed S]\n"
+                            "       %s --solve FILE [--plies N] [--nodes N] [--threads T]\n"
+                            "       %s --bench\n"
+                            "       %s --serve [HOST:]PORT|PATH [--loops L] [--seed S]\n"
+                            "       %s --loadtest [HOST:]PORT|PATH [--connections N] [--players P] [--games G]\n"
+                            "Bot kinds: scripted, random, greedy, search\n"
+                            "House rules: standard, stacking, seven-zero, jump-in, draw-until-playable, forced-play\n",
+                    argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (replayPath != NULL) {
+        return replayLog(replayPath, replayGame, replayTurn);
+    }
+    if (solvePath != NULL) {
+        return runSolver(solvePath, maxPlies, maxNodes, numThreads);
+    }
+    if (serveAddress != NULL) {
+        return runServer(serveAddress, numLoops > 0 ? numLoops : numThreads, seed, rules);
+    }
+    if (loadTestAddress != NULL) {
+        if (numPlayers < 2 || numPlayers > MAX_PLAYERS || numConnections < numPlayers || numRounds < 1) {
+            fprintf(stderr, "A load test needs 2 to %d players, at least one table and one game.\n", MAX_PLAYERS);
+            return 1;
+        }
+        return runLoadTest(loadTestAddress, numConnections, numPlayers, numRounds);
+    }
+    if (logPath != NULL) {
+        sessionLog = openLogWriter(logPath);
+        if (sessionLog == NULL) {
+            fprintf(stderr, "Could not open the log file %s, or it is not a replay log of this version.\n", logPath);
+            return 1;
+        }
+    }
+    if (searchBudget.playouts <= 0 && searchBudget.seconds <= 0) {
+        fprintf(stderr, "Search bots need a playout or time budget.\n");
+        return 1;
+    }
+    if (tournamentList != NULL) {
+        return runTournament(tournamentList, maxGames, numThreads, seed, rules);
+    }
+    if (numGames > 0) {
+        if (numPlayers < 2 || numPlayers > MAX_PLAYERS) {
+            fprintf(stderr, "Number of players must be between 2 and %d.\n", MAX_PLAYERS);
+            return 1;
+        }
+        if (numThreads < 1) {
+            numThreads = 1;
+        }
+        // Seats without a kind in the list are scripted, the last kind given fills the rest
+        enum StrategyKind kind = STRATEGY_SCRIPTED;
+        char* list = botList != NULL ? strdup(botList) : NULL;
+        char* token = list != NULL ? strtok(list, ",") : NULL;
+        for (int seat = 0; seat < numPlayers; seat++) {
+            if (token != NULL) {
+                if (!parseStrategyKind(token, &kind) || kind == STRATEGY_HUMAN) {
+                    fprintf(stderr, "Unknown bot kind %s.\n", token);
+                    free(list);
+                    return 1;
+                }
+                token = strtok(NULL, ",");
+            }
+            kinds[seat] = kind;
+        }
+        free(list);
+        for (int seat = 0; batched && seat < numPlayers; seat++) {
+            if (kinds[seat] != STRATEGY_SCRIPTED || sessionLog != NULL || eventsPath != NULL || rules != 0) {
+                fprintf(stderr, "The batch engine only plays scripted bots by the standard rules, without a log or events.\n");
+                return 1;
+            }
+        }
+        // Games already run in parallel, so each search uses a single thread unless asked otherwise
+        if (searchBudget.threads < 1) {
+            searchBudget.threads = 1;
+        }
+        // Every simulation thread is a table of its own
+        if (eventsPath != NULL && (sessionEvents = startEventListeners(eventsPath, numThreads)) == NULL) {
+            fprintf(stderr, "Could not open the event file %s.\n", eventsPath);
+            return 1;
+        }
+        simulateGames(numGames, numPlayers, kinds, rules, numThreads, seed, sessionLog, batched);
+        if (sessionLog != NULL) {
+            closeLogWriter(sessionLog);
+        }
+        if (sessionEvents != NULL) {
+            stopEventListeners(sessionEvents);
+        }
+        return 0;
+    }
+
+    if (searchBudget.threads < 1) {
+        searchBudget.threads = numThreads > 0 ? numThreads : 1;
+    }
+
+    if (scriptPath != NULL && !openScriptInput(scriptPath)) {
+        fprintf(stderr, "Could not open the script %s.\n", scriptPath);
+        return 1;
+    }
+    if (eventsPath != NULL && (sessionEvents = startEventListeners(eventsPath, 1)) == NULL) {
+        fprintf(stderr, "Could not open the event file %s.\n", eventsPath);
+        return 1;
+    }
 
     printf("Welcome to Uno Game!\n");
 
@@ -85,14 +777,18 @@ int main() {
         printf("1. Play Game\n");
         printf("2. Instructions\n");
         printf("3. Credits\n");
-        printf("4. Exit\n");
+        printf("4. Load Saved Game\n");
+        printf("5. Exit\n");
         printf("Enter your choice: ");
-        scanf("%d", &choice);
+        if (!readChoice(&choice)) {
+            choice = 5; // End of the input
+        }
 
         // Perform action based on user choice
         switch (choice) {
             case 1:
-                playGame();
+                // Every game of the session gets the next seed
+                playGame(seed++, rules);
                 break;
             case 2:
                 displayInstructions();
@@ -101,103 +797,323 @@ int main() {
                 displayCredits();
                 break;
             case 4:
+                resumeGame();
+                break;
+            case 5:
                 printf("Exiting the game. Goodbye!\n");
                 break;
             default:
-                printf("Invalid choice. Please enter a number between 1 and 4.\n");
+                printf("Invalid choice. Please enter a number between 1 and 5.\n");
 
         }
-    } while (choice != 4);
+    } while (choice != 5);
 
+    if (sessionLog != NULL) {
+        closeLogWriter(sessionLog);
+    }
+    if (sessionEvents != NULL) {
+        stopEventListeners(sessionEvents);
+    }
+#ifdef UNO_TELEMETRY
+    if (telemetryFormat != NULL) {
+        printThreadTelemetry(telemetryFormat);
+    }
+#endif
     return 0;
 }
 
-// Function to create a card
-struct Card* createCard(enum Color color, enum Type type) {
-    struct Card* newCard = (struct Card*)malloc(sizeof(struct Card));
-    newCard->color = color;
-    newCard->type = type;
-    newCard->next = NULL;
-    return newCard;
+// Function to get the id of a card: colored cards are numbered color by color,
+// Wild and Wild Draw Four take the last two ids
+unsigned char makeCard(enum Color color, enum Type type) {
+    if (color == SPECIAL) {
+        return 4 * 13 + (type - WILD);
+    }
+    return color * 13 + type;
 }
 
-// Function to add a new card to the deck
-void addCardToDeck(struct Card** deck, struct Card* newCard) {
-    if (*deck == NULL) {
-        *deck = newCard;
-    } else {
-        struct Card* current = *deck;
-        while (current->next != NULL) {
-            current = current->next;
+// Function to get the color of a card id
+enum Color cardColor(unsigned char card) {
+    return card >= 4 * 13 ? SPECIAL : (enum Color)(card / 13);
+}
+
+// Function to get the type of a card id
+enum Type cardType(unsigned char card) {
+    return card >= 4 * 13 ? (enum Type)(WILD + card - 4 * 13) : (enum Type)(card % 13);
+}
+
+#define CARD(color, type) ((color) * 13 + (type))
+#define NUMBER_CARDS(color) \
+    CARD(color, ONE), CARD(color, TWO), CARD(color, THREE), CARD(color, FOUR), CARD(color, FIVE), \
+    CARD(color, SIX), CARD(color, SEVEN), CARD(color, EIGHT), CARD(color, NINE)
+#define ACTION_CARDS(color) CARD(color, SKIP), CARD(color, REVERSE), CARD(color, DRAW_TWO)
+#define WILD_CARDS CARD(SPECIAL, 0), CARD(SPECIAL, 1)
+
+// Bit masks over card ids
+#define CARD_BIT(card) (1ULL << (card))
+#define COLOR_MASK(color) (0x1FFFULL << ((color) * 13))
+#define TYPE_MASK(type) (CARD_BIT(type) | CARD_BIT(13 + (type)) | CARD_BIT(26 + (type)) | CARD_BIT(39 + (type)))
+#define WILD_MASK (CARD_BIT(CARD(SPECIAL, 0)) | CARD_BIT(CARD(SPECIAL, 1)))
+
+// The 108 cards of a new deck, in the order they are printed
+static const unsigned char canonicalDeck[DECK_SIZE] = {
+    // Number cards (1-9), two of each
+    NUMBER_CARDS(RED), NUMBER_CARDS(BLUE), NUMBER_CARDS(GREEN), NUMBER_CARDS(YELLOW),
+    NUMBER_CARDS(RED), NUMBER_CARDS(BLUE), NUMBER_CARDS(GREEN), NUMBER_CARDS(YELLOW),
+    // One zero per color
+    CARD(RED, ZERO), CARD(BLUE, ZERO), CARD(GREEN, ZERO), CARD(YELLOW, ZERO),
+    // Special cards (Skip, Reverse, Draw Two), two of each
+    ACTION_CARDS(RED), ACTION_CARDS(BLUE), ACTION_CARDS(GREEN), ACTION_CARDS(YELLOW),
+    ACTION_CARDS(RED), ACTION_CARDS(BLUE), ACTION_CARDS(GREEN), ACTION_CARDS(YELLOW),
+    // Wild cards (Wild, Wild Draw Four), four of each
+    WILD_CARDS, WILD_CARDS, WILD_CARDS, WILD_CARDS
+};
+
+// Function to initialize the deck with a number of new decks
+void initializeDeck(struct Deck* deck, int numDecks) {
+    for (int i = 0; i < numDecks; i++) {
+        memcpy(deck->cards + i * DECK_SIZE, canonicalDeck, sizeof(canonicalDeck));
+    }
+    deck->count = numDecks * DECK_SIZE;
+}
+
+// Function to step a splitmix64 generator, used to expand seeds
+static unsigned long long splitMix64(unsigned long long* state) {
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Function to get the seed of one simulated game, so results do not depend on
+// which thread plays it
+static unsigned long long gameSeed(unsigned long long masterSeed, long gameIndex) {
+    unsigned long long state = masterSeed + (unsigned long long)gameIndex * 0xD1B54A32D192ED03ULL;
+    return splitMix64(&state);
+}
+
+// Function to rotate a 64-bit number left
+static inline unsigned long long rotl(unsigned long long x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// Function to seed a random number generator, the same seed always gives the same numbers
+void rngSeed(struct Rng* rng, unsigned long long seed) {
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitMix64(&seed);
+    }
+}
+
+// Function to get the next random number
+unsigned long long rngNext(struct Rng* rng) {
+    unsigned long long* s = rng->s;
+    unsigned long long result = rotl(s[1] * 5, 7) * 9;
+    unsigned long long t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+// Function to get a random number between 0 and bound - 1 without modulo bias
+// (Lemire's multiply-shift on the upper 32 bits, rejecting the few values that would bias it)
+unsigned int rngBounded(struct Rng* rng, unsigned int bound) {
+    unsigned long long m = (rngNext(rng) >> 32) * bound;
+    unsigned int low = (unsigned int)m;
+    if (low < bound) {
+        unsigned int threshold = -bound % bound;
+        while (low < threshold) {
+            m = (rngNext(rng) >> 32) * bound;
+            low = (unsigned int)m;
         }
-        current->next = newCard;
     }
+    return (unsigned int)(m >> 32);
 }
 
-// Function to initialize the deck
-void initializeDeck(struct Card** deck) {
-    // Initialize number cards (0-9)
-    for (int i = 0; i < 2; i++) {
-        for (enum Color color = RED; color <= YELLOW; color++) {
-            for (enum Type type = ONE; type <= NINE; type++) {
-                struct Card* newCard = createCard(color, type);
-                // Add newCard to the deck (linked list)
-                addCardToDeck(deck, newCard);
+// Function to advance a generator by 2^128 numbers, giving a stream that never overlaps the old one
+void rngJump(struct Rng* rng) {
+    static const unsigned long long jump[4] = {
+        0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL, 0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL
+    };
+    unsigned long long s[4] = { 0 };
+    for (int i = 0; i < 4; i++) {
+        for (int bit = 0; bit < 64; bit++) {
+            if (jump[i] & (1ULL << bit)) {
+                for (int k = 0; k < 4; k++) {
+                    s[k] ^= rng->s[k];
+                }
             }
+            rngNext(rng);
         }
     }
+    memcpy(rng->s, s, sizeof(s));
+}
 
-    // Creating Zeros
-    for (enum Color color = RED; color <= YELLOW; color++) {
-        struct Card* newCard = createCard(color, ZERO);
-        // Add newCard to the deck (linked list)
-        addCardToDeck(deck, newCard);
+// Function to split off an independent stream: the child takes the current stream
+// and the parent jumps ahead to a fresh one
+void rngSplit(struct Rng* rng, struct Rng* child) {
+    *child = *rng;
+    rngJump(rng);
+}
+
+// Function to shuffle the deck
+void shuffleDeck(struct Deck* deck, struct Rng* rng) {
+    // Fisher-Yates shuffle algorithm
+    for (int i = deck->count - 1; i > 0; i--) {
+        int j = rngBounded(rng, i + 1);
+        unsigned char temp = deck->cards[i];
+        deck->cards[i] = deck->cards[j];
+        deck->cards[j] = temp;
     }
+}
 
-    // Add special cards (Skip, Reverse, Draw Two)
-    for (int i = 0; i < 2; i++) {
-        for (enum Color color = RED; color <= YELLOW; color++) {
-            addCardToDeck(deck, createCard(color, SKIP));
-            addCardToDeck(deck, createCard(color, REVERSE));
-            addCardToDeck(deck, createCard(color, DRAW_TWO));
+// Batch shuffle kernel: SHUFFLE_LANES decks of the same size go through Fisher-Yates together, every
+// deck with its own generator. The generators step in vectors, the bounded numbers come from one
+// multiply per lane, and the swaps are done lane by lane. Each deck comes out exactly as shuffleDeck
+// would leave it with the same generator: the rare number Lemire's method rejects is drawn again in
+// that lane alone. The widest kernel the processor runs is picked once, at the first shuffle.
+
+// Function to get the next number of the generator of one lane (the same sequence as rngNext)
+static inline unsigned long long shuffleLaneNext(struct ShuffleLanes* lanes, int k) {
+    struct Rng rng = { { lanes->s[0][k], lanes->s[1][k], lanes->s[2][k], lanes->s[3][k] } };
+    unsigned long long result = rngNext(&rng);
+    for (int word = 0; word < 4; word++) {
+        lanes->s[word][k] = rng.s[word];
+    }
+    return result;
+}
+
+// Function to finish a step of the kernels once every lane drew a number: turn the products of the
+// upper halves by the bound into places, drawing again where rngBounded would, and swap
+static inline void shuffleLanesSwap(struct ShuffleLanes* lanes, const unsigned long long* products, int i) {
+    unsigned int bound = i + 1;
+    for (int k = 0; k < lanes->numLanes; k++) {
+        unsigned long long m = products[k];
+        unsigned int low = (unsigned int)m;
+        if (low < bound) {
+            unsigned int threshold = -bound % bound;
+            while (low < threshold) {
+                m = (shuffleLaneNext(lanes, k) >> 32) * bound;
+                low = (unsigned int)m;
+            }
         }
+        unsigned char* cards = lanes->cards[k];
+        int j = (int)(m >> 32);
+        unsigned char temp = cards[i];
+        cards[i] = cards[j];
+        cards[j] = temp;
     }
+}
 
-    // Add Wild cards (Wild, Wild Draw Four)
-    for (int i = 0; i < 4; i++) {
-        addCardToDeck(deck, createCard(SPECIAL, WILD));
-        addCardToDeck(deck, createCard(SPECIAL, WILD_DRAW));
+// Portable kernel: the last steps of Fisher-Yates on every lane, one lane after the other
+static void shuffleLanesScalar(struct ShuffleLanes* lanes, int count, int steps) {
+    unsigned long long products[SHUFFLE_LANES];
+    for (int i = count - 1; i > 0 && i >= count - steps; i--) {
+        for (int k = 0; k < lanes->numLanes; k++) {
+            products[k] = (shuffleLaneNext(lanes, k) >> 32) * (unsigned int)(i + 1);
+        }
+        shuffleLanesSwap(lanes, products, i);
     }
 }
 
-// Function to shuffle the deck
-void shuffleDeck(struct Card** deck) {
-    struct Card* current = *deck;
-    int numCards = 0;
-    while (current != NULL) {
-        numCards++;
-        current = current->next;
+#if defined(__x86_64__) || defined(__i386__)
+// The vector kernels: one xoshiro256** step per vector of lanes, with the multiplications by 5 and 9 made
+// of shifts and adds, and the upper half of each number times the bound as an unsigned 32-bit multiply
+#define SHUFFLE_KERNEL(name, isa, vector, width, load, store, set1, add, vxor, slli, srli, rotl, mul) \
+    __attribute__((target(isa))) \
+    static void name(struct ShuffleLanes* lanes, int count, int steps) { \
+        unsigned long long products[SHUFFLE_LANES] __attribute__((aligned(64))); \
+        for (int i = count - 1; i > 0 && i >= count - steps; i--) { \
+            vector bound = set1((long long)(i + 1)); \
+            for (int k = 0; k < SHUFFLE_LANES; k += width) { \
+                vector s0 = load((vector*)&lanes->s[0][k]); \
+                vector s1 = load((vector*)&lanes->s[1][k]); \
+                vector s2 = load((vector*)&lanes->s[2][k]); \
+                vector s3 = load((vector*)&lanes->s[3][k]); \
+                vector times5 = add(s1, slli(s1, 2)); \
+                vector rotated = rotl(times5, 7); \
+                vector result = add(rotated, slli(rotated, 3)); \
+                vector t = slli(s1, 17); \
+                s2 = vxor(s2, s0); \
+                s3 = vxor(s3, s1); \
+                s1 = vxor(s1, s2); \
+                s0 = vxor(s0, s3); \
+                s2 = vxor(s2, t); \
+                s3 = rotl(s3, 45); \
+                store((vector*)&lanes->s[0][k], s0); \
+                store((vector*)&lanes->s[1][k], s1); \
+                store((vector*)&lanes->s[2][k], s2); \
+                store((vector*)&lanes->s[3][k], s3); \
+                store((vector*)&products[k], mul(srli(result, 32), bound)); \
+            } \
+            shuffleLanesSwap(lanes, products, i); \
+        } \
     }
 
-    // Fisher-Yates shuffle algorithm
-    current = *deck;
-    for (int i = 0; i < numCards - 1; i++) {
-        int j = i + rand() % (numCards - i);
-        struct Card* temp1 = *deck;
-        struct Card* temp2 = *deck;
-        for (int k = 0; k < i; k++) {
-            temp1 = temp1->next;
+#define ROTL_SSE2(x, k) _mm_or_si128(_mm_slli_epi64(x, k), _mm_srli_epi64(x, 64 - (k)))
+#define ROTL_AVX2(x, k) _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - (k)))
+SHUFFLE_KERNEL(shuffleLanesSse2, "sse2", __m128i, 2, _mm_load_si128, _mm_store_si128, _mm_set1_epi64x,
+               _mm_add_epi64, _mm_xor_si128, _mm_slli_epi64, _mm_srli_epi64, ROTL_SSE2, _mm_mul_epu32)
+SHUFFLE_KERNEL(shuffleLanesAvx2, "avx2", __m256i, 4, _mm256_load_si256, _mm256_store_si256, _mm256_set1_epi64x,
+               _mm256_add_epi64, _mm256_xor_si256, _mm256_slli_epi64, _mm256_srli_epi64, ROTL_AVX2,
+               _mm256_mul_epu32)
+SHUFFLE_KERNEL(shuffleLanesAvx512, "avx512f", __m512i, 8, _mm512_load_si512, _mm512_store_si512, _mm512_set1_epi64,
+               _mm512_add_epi64, _mm512_xor_si512, _mm512_slli_epi64, _mm512_srli_epi64,
+               _mm512_rol_epi64, _mm512_mul_epu32)
+#endif
+
+// Kernel picked for this processor, and its name
+static void (*shuffleKernel)(struct ShuffleLanes* lanes, int count, int steps);
+static const char* shuffleKernelName;
+static pthread_once_t shuffleKernelOnce = PTHREAD_ONCE_INIT;
+
+// Function to pick the widest kernel the processor runs
+static void selectShuffleKernel() {
+    shuffleKernel = shuffleLanesScalar;
+    shuffleKernelName = "scalar";
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        shuffleKernel = shuffleLanesAvx512;
+        shuffleKernelName = "avx512";
+    } else if (__builtin_cpu_supports("avx2")) {
+        shuffleKernel = shuffleLanesAvx2;
+        shuffleKernelName = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        shuffleKernel = shuffleLanesSse2;
+        shuffleKernelName = "sse2";
+    }
+#endif
+}
+
+// Function to run the last steps of Fisher-Yates on the decks of the lanes, each count cards long:
+// the cards that end up in the last steps places are those a deal of steps cards would take,
+// and shuffling all of a deck takes count - 1 steps
+void shuffleLanes(struct ShuffleLanes* lanes, int count, int steps) {
+    pthread_once(&shuffleKernelOnce, selectShuffleKernel);
+    shuffleKernel(lanes, count, steps);
+}
+
+// Function to shuffle many decks of the same size, each with its own generator, SHUFFLE_LANES at a time
+void shuffleDecks(struct Deck* decks, struct Rng* rngs, int numDecks) {
+    struct ShuffleLanes lanes;
+    for (int first = 0; first < numDecks; first += SHUFFLE_LANES) {
+        memset(&lanes, 0, sizeof(lanes));
+        lanes.numLanes = numDecks - first < SHUFFLE_LANES ? numDecks - first : SHUFFLE_LANES;
+        for (int k = 0; k < lanes.numLanes; k++) {
+            lanes.cards[k] = decks[first + k].cards;
+            for (int word = 0; word < 4; word++) {
+                lanes.s[word][k] = rngs[first + k].s[word];
+            }
         }
-        for (int k = 0; k < j; k++) {
-            temp2 = temp2->next;
+        shuffleLanes(&lanes, decks[first].count, decks[first].count);
+        for (int k = 0; k < lanes.numLanes; k++) {
+            for (int word = 0; word < 4; word++) {
+                rngs[first + k].s[word] = lanes.s[word][k];
+            }
         }
-        // Swap card data
-        enum Color temp_color = temp1->color;
-        enum Type temp_type = temp1->type;
-        temp1->color = temp2->color;
-        temp1->type = temp2->type;
-        temp2->color = temp_color;
-        temp2->type = temp_type;
     }
 }
 
@@ -233,114 +1149,281 @@ const char* getTypeName(enum Type type) {
         default: return "Unknown";
     }}
 
-// Function to print a card
-void printCard(struct Card* card) {
-    printf("[%s, %s]", getColorName(card->color), getTypeName(card->type));
-}
+// Render buffer of the interactive game, the game runs on the main thread only
+static struct RenderBuffer render = { RENDER_PLAIN, NULL, 0, 0, NULL, 0, 0 };
 
+// Function to choose how game output is shown. Redrawing only works on a terminal,
+// elsewhere the text is written as it is.
+void setRenderMode(enum RenderMode mode) {
+    if (mode == RENDER_ANSI && !isatty(STDOUT_FILENO)) {
+        mode = RENDER_PLAIN;
+    }
+    render.mode = mode;
+}
 
-// Function to deallocate a single card
-void freeCard(struct Card* card) {
-    free(card);
+// Function to add formatted text to the render buffer
+void renderf(const char* format, ...) {
+    if (render.mode == RENDER_QUIET) {
+        return;
+    }
+    while (1) {
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(render.text + render.used, render.capacity - render.used, format, args);
+        va_end(args);
+        if (length >= 0 && render.used + length < render.capacity) {
+            render.used += length;
+            return;
+        }
+        render.capacity = render.capacity == 0 ? RENDER_BUFFER_SIZE : 2 * render.capacity;
+        while (length >= 0 && render.used + length >= render.capacity) {
+            render.capacity *= 2;
+        }
+        render.text = (char*)realloc(render.text, render.capacity);
+    }
 }
 
-// Function to deallocate the entire deck
-void freeDeck(struct Card* deck) {
-    struct Card* current = deck;
-    while (current != NULL) {
-        struct Card* next = current->next;
-        freeCard(current);
-        current = next;
+// Function to write all of a buffer to standard output with as few system calls as possible
+static void writeOut(const char* data, size_t size) {
+    fflush(stdout);
+    while (size > 0) {
+        ssize_t written = write(STDOUT_FILENO, data, size);
+        if (written <= 0) {
+            return;
+        }
+        data += written;
+        size -= written;
     }
 }
 
-// Function to create players
-struct Player* createPlayer(const char* name) {
-    struct Player* newPlayer = (struct Player*)malloc(sizeof(struct Player));
-    strcpy(newPlayer->name, name);
-    newPlayer->hand = NULL;
-    newPlayer->next = NULL;
-    newPlayer->prev = NULL;
-    return newPlayer;
+// Function to get the next line of a frame, returns its length
+static size_t frameLine(const char* text, size_t size, size_t start) {
+    const char* end = memchr(text + start, '\n', size - start);
+    return end == NULL ? size - start : (size_t)(end - text) - start;
 }
 
-// Function to add a player to the list
-void addPlayerToList(struct Player** firstPlayer, struct Player* newPlayer) {
-    if (*firstPlayer == NULL) {
-        *firstPlayer = newPlayer;
+// Function to redraw the frame in the render buffer over the one on the screen. Only the lines
+// that changed are rewritten; the last line, where input is typed, always is. A frame taller than
+// the terminal is written in full after clearing the screen.
+static void redrawFrame() {
+    struct winsize window;
+    int rows = ioctl(STDOUT_FILENO, TIOCGWINSZ, &window) == 0 && window.ws_row > 0 ? window.ws_row : 24;
+    int numLines = 1;
+    for (size_t i = 0; i < render.used; i++) {
+        numLines += render.text[i] == '\n';
+    }
+
+    // The escape sequences are built in a second buffer and written at once
+    size_t capacity = 2 * render.used + 16 * numLines + 64;
+    char* out = (char*)malloc(capacity);
+    size_t used = 0;
+    if (render.screen == NULL || numLines > rows) {
+        used += sprintf(out, "\x1b[H\x1b[2J");
+        memcpy(out + used, render.text, render.used);
+        used += render.used;
     } else {
-        struct Player* current = *firstPlayer;
-        while (current->next != NULL && current->next != *firstPlayer) {
-            current = current->next;
+        size_t start = 0;
+        size_t oldStart = 0;
+        for (int row = 1; row <= numLines; row++) {
+            size_t length = frameLine(render.text, render.used, start);
+            bool changed = row == numLines || row >= render.screenLines;
+            if (!changed) {
+                size_t oldLength = frameLine(render.screen, render.screenSize, oldStart);
+                changed = oldLength != length || memcmp(render.screen + oldStart, render.text + start, length) != 0;
+                oldStart += oldLength + 1;
+            }
+            if (changed) {
+                used += sprintf(out + used, "\x1b[%d;1H", row);
+                memcpy(out + used, render.text + start, length);
+                used += length;
+                used += sprintf(out + used, "\x1b[K%s", row == numLines ? "\x1b[J" : "");
+            }
+            start += length + 1;
         }
-        current->next = newPlayer;
-        newPlayer->prev = current;
     }
-    // Make the list circular
-    newPlayer->next = *firstPlayer;
-    (*firstPlayer)->prev = newPlayer;
+    writeOut(out, used);
+    free(out);
+
+    // Remember what is on the screen; a frame that scrolled leaves it unknown
+    free(render.screen);
+    render.screen = NULL;
+    if (numLines <= rows) {
+        render.screen = (char*)malloc(render.used + 1);
+        memcpy(render.screen, render.text, render.used);
+        render.screenSize = render.used;
+        render.screenLines = numLines;
+    }
 }
 
-// Function to deal a card
-void dealCard(struct Card** deck, struct Player* player) {
-    struct Card* current = *deck;
-    *deck = (*deck)->next;
-    current->next = NULL;
-    if (player->hand == NULL) {
-        player->hand = current;
-    } else {
-        struct Card* temp = player->hand;
-        while (temp->next != NULL) {
-            temp = temp->next;
-        }
-        temp->next = current;
+// Function to show what was rendered, called when the game waits for input and at the end of a turn
+void renderFlush() {
+    if (render.mode == RENDER_ANSI) {
+        redrawFrame();
+        return;
+    }
+    writeOut(render.text, render.used);
+    render.used = 0;
+}
+
+// Function to start a new frame: in ANSI mode the next redraw only shows what is rendered from now on
+void renderNewFrame() {
+    if (render.mode == RENDER_ANSI) {
+        render.used = 0;
+    }
+}
+
+// Function to forget what is on the screen, so the next redraw starts from a cleared screen.
+// Called when text was written around the render buffer, like the menus.
+void renderReset() {
+    if (render.mode == RENDER_ANSI) {
+        render.used = 0;
+        free(render.screen);
+        render.screen = NULL;
+    }
+}
+
+// Function to print a card
+void printCard(struct Card* card) {
+    renderf("[%s, %s]", getColorName(card->color), getTypeName(card->type));
+}
+
+
+// Allocation counters for the arenas of the current thread
+static _Thread_local struct AllocCounters allocCounters;
+
+#ifdef UNO_TELEMETRY
+// Telemetry of the current thread, merged into the totals when a simulation thread ends
+static _Thread_local struct Telemetry telemetry;
+
+// Function to read a monotonic clock in nanoseconds
+static inline unsigned long long telemetryClock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Function to add a value to a histogram of the current thread
+static inline void telemetryRecord(enum TelemetryHistogram histogram, unsigned long long value) {
+    telemetry.buckets[histogram][value == 0 ? 0 : 64 - __builtin_clzll(value)]++;
+    telemetry.sums[histogram] += value;
+}
+
+#define TELEMETRY_COUNT(counter, n) (telemetry.counters[counter] += (n))
+#define TELEMETRY_RECORD(histogram, value) telemetryRecord(histogram, value)
+#define TELEMETRY_START(timer) unsigned long long timer = telemetryClock()
+#define TELEMETRY_STOP(histogram, timer) telemetryRecord(histogram, telemetryClock() - (timer))
+#else
+// Compiled out: the hooks vanish and cost nothing
+#define TELEMETRY_COUNT(counter, n) ((void)0)
+#define TELEMETRY_RECORD(histogram, value) ((void)0)
+#define TELEMETRY_START(timer) ((void)0)
+#define TELEMETRY_STOP(histogram, timer) ((void)0)
+#endif
+
+// Function to set up an arena with a single block of the given size
+void arenaInit(struct Arena* arena, size_t capacity) {
+    arena->block = (unsigned char*)malloc(capacity);
+    if (arena->block == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(1);
+    }
+    arena->capacity = capacity;
+    arena->used = 0;
+    allocCounters.blocksAllocated++;
+    allocCounters.bytesInUse += capacity;
+}
+
+// Function to hand out memory from an arena, aligned for any type
+void* arenaAlloc(struct Arena* arena, size_t size) {
+    size_t start = (arena->used + 15) & ~(size_t)15;
+    if (start + size > arena->capacity) {
+        fprintf(stderr, "Arena of %zu bytes is full.\n", arena->capacity);
+        exit(1);
     }
+    arena->used = start + size;
+    return arena->block + start;
+}
+
+// Function to release everything allocated from an arena at once
+void arenaRelease(struct Arena* arena) {
+    free(arena->block);
+    allocCounters.blocksReleased++;
+    allocCounters.bytesInUse -= arena->capacity;
+    arena->block = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
+
+// Function to set up a player in its seat, with a copy of its name in the arena
+void initPlayer(struct Arena* arena, struct Player* player, const char* name, int seat) {
+    size_t length = strlen(name);
+    player->name = (char*)arenaAlloc(arena, length + 1);
+    memcpy(player->name, name, length + 1);
+    memset(&player->hand, 0, sizeof(player->hand));
+    player->strategy = NULL;
+    player->seat = seat;
+}
+
+// Function to take the card at a place of the deck: the card is swapped with the last one and the
+// deck shrinks by one, so the deck never needs a full shuffle
+static unsigned char takeCard(struct Deck* deck, int slot) {
+    unsigned char card = deck->cards[slot];
+    deck->cards[slot] = deck->cards[--deck->count];
+    return card;
+}
+
+// Function to take a card picked at random from the deck
+static unsigned char takeRandomCard(struct Deck* deck, struct Rng* rng) {
+    return takeCard(deck, rngBounded(rng, deck->count));
+}
+
+// Function to deal a random card of the deck, returns the card that was dealt
+unsigned char dealCard(struct Deck* deck, struct Rng* rng, struct Player* player) {
+    unsigned char card = takeRandomCard(deck, rng);
+    addCardToHand(&player->hand, card);
+    return card;
 }
 
 // Function to deal cards to players
-void dealCards(struct Card** deck, struct Player* firstPlayer, int numPlayers, int numCardsPerPlayer) {
-    struct Player* currentPlayer = firstPlayer;
+void dealCards(struct Deck* deck, struct Rng* rng, struct Player* players, int numPlayers, int numCardsPerPlayer) {
     for (int i = 0; i < numPlayers; i++) {
         for (int j = 0; j < numCardsPerPlayer; j++) {
-            dealCard(deck, currentPlayer);
+            dealCard(deck, rng, &players[i]);
         }
-        currentPlayer = currentPlayer->next; // Move to the next player
     }
 }
 
-// Function to display a player's hand
+// Function to display a player's hand, sorted by color and type
 void displayHand(struct Player* player) {
-    printf("\nHand of %s:\n", player->name);
-    struct Card* currentCard = player->hand;
-    while (currentCard != NULL) {
-        // Print card details
-        printf("[%s, %s]\n", getColorName(currentCard->color), getTypeName(currentCard->type));
-        currentCard = currentCard->next;
+    renderf("\nHand of %s:\n", player->name);
+    for (unsigned long long mask = player->hand.mask; mask != 0; mask &= mask - 1) {
+        unsigned char card = __builtin_ctzll(mask);
+        for (int i = 0; i < player->hand.counts[card]; i++) {
+            // Print card details
+            renderf("[%s, %s]\n", getColorName(cardColor(card)), getTypeName(cardType(card)));
+        }
     }
 }
 
+// Function to add a card to a hand
+void addCardToHand(struct Hand* hand, unsigned char card) {
+    hand->counts[card]++;
+    hand->mask |= CARD_BIT(card);
+    hand->size++;
+}
+
 // Function to remove a card from a player's hand
-void removeCardFromHand(struct Player* player, struct Card* cardToRemove) {
-    struct Card* current = player->hand;
-    struct Card* prev = NULL;
-
-    // Traverse the linked list to find the card to remove
-    while (current != NULL) {
-        if (current == cardToRemove) {
-            // If the card to remove is the first card in the hand
-            if (prev == NULL) {
-                player->hand = current->next;
-            } else {
-                prev->next = current->next;
-            }
-            return;
-        }
-        prev = current;
-        current = current->next;
+void removeCardFromHand(struct Player* player, unsigned char cardToRemove) {
+    struct Hand* hand = &player->hand;
+    if (hand->counts[cardToRemove] == 0) {
+        // If the card to remove is not found in the hand
+        renderf("Card not found in hand.\n");
+        return;
     }
-
-    // If the card to remove is not found in the hand
-    printf("Card not found in hand.\n");
+    if (--hand->counts[cardToRemove] == 0) {
+        hand->mask &= ~CARD_BIT(cardToRemove);
+    }
+    hand->size--;
 }
 
 // Function to check if a move is valid
@@ -349,427 +1432,4770 @@ int checkValidMove(struct Card* topCard, struct Card* playedCard) {
     return (playedCard->color == topCard->color || playedCard->type == topCard->type || playedCard->color == SPECIAL );
 }
 
-// function to display last card
-void displayLastCard(struct Player* player) {
-
+// Cards that can be played on each top card for each active color. The active color is part of the
+// state of the top card: a colored card is only seen with its own color, a Wild with the chosen one.
+#define COMPATIBLE(top, color) \
+    (COLOR_MASK(color) | WILD_MASK | ((top) < CARD(SPECIAL, 0) ? TYPE_MASK((top) % 13) : 0))
+#define COMPATIBLE_ROW(top) { COMPATIBLE(top, RED), COMPATIBLE(top, BLUE), COMPATIBLE(top, GREEN), COMPATIBLE(top, YELLOW) }
+#define COMPATIBLE_ROWS(color) \
+    COMPATIBLE_ROW(CARD(color, 0)), COMPATIBLE_ROW(CARD(color, 1)), COMPATIBLE_ROW(CARD(color, 2)), \
+    COMPATIBLE_ROW(CARD(color, 3)), COMPATIBLE_ROW(CARD(color, 4)), COMPATIBLE_ROW(CARD(color, 5)), \
+    COMPATIBLE_ROW(CARD(color, 6)), COMPATIBLE_ROW(CARD(color, 7)), COMPATIBLE_ROW(CARD(color, 8)), \
+    COMPATIBLE_ROW(CARD(color, 9)), COMPATIBLE_ROW(CARD(color, 10)), COMPATIBLE_ROW(CARD(color, 11)), \
+    COMPATIBLE_ROW(CARD(color, 12))
+static const unsigned long long compatibleCards[NUM_CARD_IDS][SPECIAL] = {
+    COMPATIBLE_ROWS(RED), COMPATIBLE_ROWS(BLUE), COMPATIBLE_ROWS(GREEN), COMPATIBLE_ROWS(YELLOW),
+    COMPATIBLE_ROW(CARD(SPECIAL, 0)), COMPATIBLE_ROW(CARD(SPECIAL, 1))
+};
 
+// Function to get the cards of a hand (as a mask of card ids) that can be played on the top card:
+// one table load and one AND
+unsigned long long legalMoveMask(unsigned long long hand, unsigned char topCard, enum Color activeColor) {
+    return hand & compatibleCards[topCard][activeColor];
+}
 
-    // Traverse the hand linked list to reach the last node
-    struct Card* currentCard = player->hand;
-    while (currentCard->next != NULL) {
-        currentCard = currentCard->next;
+// Function to get the playable cards of many hands at once, a loop the compiler vectorizes
+void legalMoveMasks(const unsigned long long* hands, const unsigned char* topCards,
+                    const unsigned char* activeColors, unsigned long long* masks, int count) {
+    for (int i = 0; i < count; i++) {
+        masks[i] = hands[i] & compatibleCards[topCards[i]][activeColors[i]];
     }
-
-    // Print the details of the last card
-    printf("[%s, %s]\n", getColorName(currentCard->color), getTypeName(currentCard->type));
 }
 
-// Function to deallocate a single player
-void freePlayer(struct Player* player) {
-    free(player);
+// function to display the card that was just drawn
+void displayLastCard(unsigned char card) {
+    // Print the details of the card
+    renderf("[%s, %s]\n", getColorName(cardColor(card)), getTypeName(cardType(card)));
 }
 
-// Function to deallocate the entire list of players
-void freePlayerList(struct Player* firstPlayer) {
-    struct Player* current = firstPlayer;
-    do {
-        struct Player* next = current->next;
-        freePlayer(current);
-        current = next;
-    } while (current != firstPlayer);
+// Function to check if a card cannot be used as the starting card
+static bool isActionCard(enum Color color, enum Type type) {
+    return color == SPECIAL || type == SKIP || type == REVERSE || type == DRAW_TWO;
 }
 
+// Function to get the top card of the discard pile, with the chosen color for a Wild
+static struct Card getTopCard(struct Game* game) {
+    unsigned char top = game->discardPile->cards[game->discardPile->count - 1];
+    return (struct Card){ game->activeColor, cardType(top) };
+}
 
-// SkipTurn function
-void SkipTurn(struct Player** currentPlayer) {
-    printf("Skipping the next player's turn.\n");
-    *currentPlayer = (*currentPlayer)->next; // Move to the next player
+// Function to get the number of decks shuffled together for a table
+static int decksForPlayers(int numPlayers) {
+    return (numPlayers + PLAYERS_PER_DECK - 1) / PLAYERS_PER_DECK;
 }
 
-// Wild card Function
-void Wild(struct Card* card) {
-    printf("Choose the color for the next play:\n");
-    printf("1. RED\n2. BLUE\n3. GREEN\n4. YELLOW\n");
-    int choice;
-    scanf("%d", &choice);
+// Function to allocate a game and its players, seated in order with empty hands.
+// The game, its piles, its players and their names live in one arena block released by freeGame.
+static struct Game* allocGame(const char* names[], int numPlayers, bool verbose) {
+    int pileSize = decksForPlayers(numPlayers) * DECK_SIZE;
+    size_t size = sizeof(struct Game) + 2 * pileSize + numPlayers * sizeof(struct Player) + 16 * (numPlayers + 4);
+    for (int i = 0; i < numPlayers; i++) {
+        size += strlen(names[i]) + 1;
+    }
+    struct Arena arena;
+    arenaInit(&arena, size);
+    struct Game* game = (struct Game*)arenaAlloc(&arena, sizeof(struct Game));
+    game->arena = arena;
+    game->direction = 1;
+    game->drawnCard = -1;
+    game->winner = NULL;
+    game->numPlayers = numPlayers;
+    game->turns = 0;
+    game->rules = 0;
+    game->pendingDraw = 0;
+    game->verbose = verbose;
+    game->log = NULL;
+    game->undoLog = NULL;
+    game->events = NULL;
+    game->deck = &game->piles[0];
+    game->discardPile = &game->piles[1];
+    memset(game->discardCounts, 0, sizeof(game->discardCounts));
+    game->deck->cards = (unsigned char*)arenaAlloc(&game->arena, pileSize);
+    game->deck->count = 0;
+    game->discardPile->cards = (unsigned char*)arenaAlloc(&game->arena, pileSize);
+    game->discardPile->count = 0;
 
-    // Update the color of the Wild card based on the player's choice
-    switch(choice) {
-        case 1:
-            card->color = RED;
-            break;
-        case 2:
-            card->color = BLUE;
-            break;
-        case 3:
-            card->color = GREEN;
-            break;
-        case 4:
-            card->color = YELLOW;
-            break;
-        default:
-            printf("Invalid choice. ReEnter Your Choice .\n");
-            Wild(card);
+    game->seats = (struct Player*)arenaAlloc(&game->arena, numPlayers * sizeof(struct Player));
+    for (int i = 0; i < numPlayers; i++) {
+        initPlayer(&game->arena, &game->seats[i], names[i], i);
     }
+    game->currentPlayer = &game->seats[0];
+    return game;
 }
 
-// Draw Two Function
-void Draw_Two(struct Card** deck,struct Player* nextplayer) {
-    printf("\nPlayer %s Drew The Following Cards:\n", *nextplayer);
-    for (int i = 0; i < 2; i++) {
-dealCard(deck,nextplayer) ;
-displayLastCard(nextplayer) ;
+// Function to set up a new game: deck, players, hands and starting card
+struct Game* createGame(const char* names[], int numPlayers, bool verbose, unsigned long long seed) {
+    struct Game* game = allocGame(names, numPlayers, verbose);
+    rngSeed(&game->rng, seed);
+
+    initializeDeck(game->deck, decksForPlayers(numPlayers));
+    dealCards(game->deck, &game->rng, game->seats, numPlayers, CARDS_PER_PLAYER);
+
+    // Start the discard pile with a random card of the deck that is not a Wild or action card
+    struct Deck* deck = game->deck;
+    int top;
+    do {
+        top = rngBounded(&game->rng, deck->count);
+    } while (isActionCard(cardColor(deck->cards[top]), cardType(deck->cards[top])));
+    unsigned char topCard = deck->cards[top];
+    deck->cards[top] = deck->cards[--deck->count];
+    game->discardPile->cards[0] = topCard;
+    game->discardPile->count = 1;
+    game->discardCounts[topCard] = 1;
+    game->activeColor = cardColor(topCard);
+    return game;
+}
+
+// Function to add a change to the journal of the move being made, with what is known of the hand
+// it touches before the change
+static void recordChange(struct Game* game, enum ChangeKind kind, const struct Player* player, int card, int slot) {
+    struct UndoLog* log = game->undoLog;
+    if (log->numChanges == log->capacity) {
+        log->capacity *= 2;
+        log->changes = (struct Change*)realloc(log->changes, log->capacity * sizeof(struct Change));
+    }
+    log->changes[log->numChanges++] = (struct Change){ kind, card, player->seat, slot,
+                                                       player->hand.constrained, player->hand.excluded };
+}
+
+// Function to add an event to a ring, never waiting: returns false and counts the event as dropped
+// when the consumer is a whole ring behind
+static bool ringPublish(struct EventRing* ring, const struct GameEvent* event) {
+    unsigned long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - ring->tailSeen == EVENT_RING_SIZE) {
+        ring->tailSeen = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head - ring->tailSeen == EVENT_RING_SIZE) {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return false;
+        }
+    }
+    ring->events[head & (EVENT_RING_SIZE - 1)] = *event;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+// Function to take the oldest event of a ring, returns false when it is empty
+static bool ringPoll(struct EventRing* ring, struct GameEvent* event) {
+    unsigned long tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail == ring->headSeen) {
+        ring->headSeen = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail == ring->headSeen) {
+            return false;
+        }
+    }
+    *event = ring->events[tail & (EVENT_RING_SIZE - 1)];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// Function to publish an event of a game to every consumer of its table
+static void publishEvent(struct Game* game, enum GameEventKind kind, int seat, int card, enum Color color) {
+    struct EventBus* bus = game->events;
+    struct GameEvent event = { kind, card, color, game->direction, seat, game->turns, bus->game };
+    for (int i = 0; i < bus->numRings; i++) {
+        ringPublish(bus->rings[i], &event);
+    }
+}
+
+// Function to draw a card for a player, refilling the deck from the discard pile when it runs out.
+// Returns -1 when there is no card left to draw.
+static int drawCard(struct Game* game, struct Player* player) {
+    if (game->deck->count == 0) {
+        struct Deck* discardPile = game->discardPile;
+        if (discardPile->count <= 1) {
+            return -1;
+        }
+        if (game->verbose) {
+            renderf("Deck is empty! Putting the discard pile back into the deck.\n");
+        }
+        TELEMETRY_COUNT(TELEMETRY_RESHUFFLES, 1);
+        // The buried cards of the discard pile become the deck and the top card stays in play,
+        // moved to the bottom of the other pile. Cards are drawn at random, so nothing is shuffled.
+        game->discardPile = game->deck;
+        game->deck = discardPile;
+        game->discardPile->cards[0] = discardPile->cards[--discardPile->count];
+        game->discardPile->count = 1;
+        memset(game->discardCounts, 0, sizeof(game->discardCounts));
+        game->discardCounts[game->discardPile->cards[0]] = 1;
+        if (game->undoLog != NULL) {
+            recordChange(game, CHANGE_RECYCLE, player, game->discardPile->cards[0], 0);
+        }
+    }
+    TELEMETRY_COUNT(TELEMETRY_CARDS_DRAWN, 1);
+    int slot = rngBounded(&game->rng, game->deck->count);
+    unsigned char card = takeCard(game->deck, slot);
+    addCardToHand(&player->hand, card);
+    if (game->undoLog != NULL) {
+        recordChange(game, CHANGE_DRAW, player, card, slot);
+    }
+    if (game->events != NULL) {
+        publishEvent(game, EVENT_CARD_DRAWN, player->seat, card, SPECIAL);
+    }
+    return card;
+}
+
+// Function to add the moves that play a card, one per color for Wild cards
+static int addPlayMoves(struct Move* moves, int numMoves, unsigned char card) {
+    enum Color cardColorValue = cardColor(card);
+    if (cardColorValue == SPECIAL) {
+        for (enum Color color = RED; color <= YELLOW; color++) {
+            moves[numMoves++] = (struct Move){ MOVE_PLAY, card, color };
+        }
+    } else {
+        moves[numMoves++] = (struct Move){ MOVE_PLAY, card, cardColorValue };
+    }
+    return numMoves;
+}
+
+// Function to get the mask of the cards the current player can play
+static unsigned long long currentPlayableMask(struct Game* game) {
+    unsigned char top = game->discardPile->cards[game->discardPile->count - 1];
+    return legalMoveMask(game->currentPlayer->hand.mask, top, game->activeColor);
+}
+
+// Names of the house rules, in the order of their RULE_* bits
+static const char* ruleNames[NUM_RULES] = {
+    "stacking", "seven-zero", "jump-in", "draw-until-playable", "forced-play"
+};
+
+// Function to read a comma separated list of house rules, "standard" for none
+bool parseRules(const char* list, unsigned int* rules) {
+    *rules = 0;
+    while (*list != '\0') {
+        size_t length = strcspn(list, ",");
+        int rule = 0;
+        while (rule < NUM_RULES && (strlen(ruleNames[rule]) != length || strncasecmp(list, ruleNames[rule], length) != 0)) {
+            rule++;
+        }
+        if (rule < NUM_RULES) {
+            *rules |= 1u << rule;
+        } else if (length != 8 || strncasecmp(list, "standard", length) != 0) {
+            return false;
+        }
+        list += length + (list[length] == ',');
+    }
+    return true;
+}
+
+// The turn engine below is written once for every rule set: the rules are a constant argument of
+// always inlined functions, so each rule set compiles to code without the branches of other rules.
+#define ENGINE static inline __attribute__((always_inline))
+
+// Function to list the legal moves of the current player under a rule set, returns the number of moves
+ENGINE int listMovesWithRules(struct Game* game, struct Move* moves, const unsigned int rules) {
+    int numMoves = 0;
+    if (game->winner != NULL) {
+        return 0;
+    }
+
+    // After drawing a playable card the player may only play it or keep it
+    if (game->drawnCard >= 0) {
+        numMoves = addPlayMoves(moves, numMoves, game->drawnCard);
+        if (!(rules & RULE_FORCED_PLAY)) {
+            moves[numMoves++] = (struct Move){ MOVE_PASS, 0, SPECIAL };
+        }
+        return numMoves;
+    }
+
+    unsigned long long mask = currentPlayableMask(game);
+    if ((rules & RULE_STACKING) && game->pendingDraw > 0) {
+        // Only a Wild Draw Four, or a Draw Two on a Draw Two, stacks onto the pending draw
+        unsigned char top = game->discardPile->cards[game->discardPile->count - 1];
+        mask = game->currentPlayer->hand.mask
+             & (CARD_BIT(CARD(SPECIAL, 1)) | (cardType(top) == DRAW_TWO ? TYPE_MASK(DRAW_TWO) : 0));
+    }
+    for (; mask != 0; mask &= mask - 1) {
+        numMoves = addPlayMoves(moves, numMoves, __builtin_ctzll(mask));
+    }
+    if (!(rules & RULE_FORCED_PLAY) || numMoves == 0) {
+        moves[numMoves++] = (struct Move){ MOVE_DRAW, 0, SPECIAL };
+    }
+    return numMoves;
+}
+
+// Function to get the seat a number of steps away from another one in the direction of play,
+// for steps between -numPlayers and numPlayers. A Reverse only flips the sign of the direction.
+static inline int seatAfter(const struct Game* game, int seat, int steps) {
+    seat += game->direction * steps;
+    return seat < 0 ? seat + game->numPlayers : (seat >= game->numPlayers ? seat - game->numPlayers : seat);
+}
+
+// Function to get the player a number of steps away from another one in the direction of play
+static inline struct Player* playerAfter(const struct Game* game, const struct Player* player, int steps) {
+    return &game->seats[seatAfter(game, player->seat, steps)];
+}
+
+// Function to swap the hands of two players
+static void swapHands(struct Player* player, struct Player* other) {
+    struct Hand hand = player->hand;
+    player->hand = other->hand;
+    other->hand = hand;
+}
+
+// Function to play a 7 under the 7-0 rule: swap hands with the player holding the fewest cards,
+// the first one in the direction of play on a tie
+static void playSeven(struct Game* game, struct Player* player) {
+    struct Player* target = playerAfter(game, player, 1);
+    for (int steps = 2; steps < game->numPlayers; steps++) {
+        struct Player* other = playerAfter(game, player, steps);
+        if (other->hand.size < target->hand.size) {
+            target = other;
+        }
+    }
+    if (game->verbose) {
+        renderf("Player %s swaps hands with %s.\n", player->name, target->name);
+    }
+    if (game->undoLog != NULL) {
+        recordChange(game, CHANGE_SWAP, player, 0, target->seat);
+    }
+    swapHands(player, target);
+}
+
+// Function to move every hand one seat on, in seat order for a shift of 1 and the other way for -1
+static void passHands(struct Game* game, int shift) {
+    struct Player* seats = game->seats;
+    int first = shift > 0 ? game->numPlayers - 1 : 0;
+    struct Hand hand = seats[first].hand;
+    int seat = first;
+    for (int i = 1; i < game->numPlayers; i++, seat -= shift) {
+        seats[seat].hand = seats[seat - shift].hand;
+    }
+    seats[seat].hand = hand;
+}
+
+// Function to play a 0 under the 7-0 rule: every hand passes to the next player in the direction of play
+static void playZero(struct Game* game, struct Player* player) {
+    if (game->verbose) {
+        renderf("Every hand passes to the next player.\n");
+    }
+    if (game->undoLog != NULL) {
+        recordChange(game, CHANGE_PASS, player, 0, game->direction);
+    }
+    passHands(game, game->direction);
+}
+
+// Card counting: every player sees the cards played, the sizes of the hands and who draws instead of
+// playing. A draw shows that the player held none of the cards they could have played, for sure under
+// RULE_FORCED_PLAY and most likely otherwise. Each hand keeps that evidence as a mask of excluded card
+// ids and the number of its cards it applies to, updated in constant time at every play and draw.
+
+// Function to update what a draw tells about a hand: the cards held before it matched none of the
+// playable ones, and neither do the drawn cards that could not be played. Evidence from an earlier draw
+// only survives if it still covers the whole hand.
+static void inferDraw(struct Hand* hand, unsigned long long playable, int held, int unplayable) {
+    hand->excluded = hand->constrained == held ? hand->excluded | playable : playable;
+    hand->constrained = held + (hand->excluded == playable ? unplayable : 0);
+}
+
+// Function to update what is known of a hand when a card leaves it. A card the player seemed to lack
+// came from the cards drawn since; any other card is taken from the cards the evidence covers, which
+// may forget some evidence but never makes up any.
+static void inferPlay(struct Hand* hand, unsigned char card) {
+    if (!(hand->excluded & CARD_BIT(card)) && hand->constrained > 0) {
+        hand->constrained--;
+    }
+    if (hand->constrained > hand->size) {
+        hand->constrained = hand->size;
+    }
+}
+
+// Function to get the number of copies of a card id in one deck
+static int cardCopies(unsigned char card) {
+    return cardColor(card) == SPECIAL ? 4 : (cardType(card) == ZERO ? 1 : 2);
+}
+
+// Function to get the weight of a card id the player of a hand seemed to lack under a rule set
+static int doubtWeight(unsigned int rules) {
+    return (rules & RULE_FORCED_PLAY) ? 0 : BELIEF_DOUBT;
+}
+
+// Function to play a card from the current player's hand and apply its effect under a rule set
+ENGINE void playCardWithRules(struct Game* game, unsigned char card, enum Color color, const unsigned int rules) {
+    struct Player* player = game->currentPlayer;
+    struct Card face = { cardColor(card), cardType(card) };
+    if (game->verbose) {
+        renderf("Player %s played ", player->name);
+        printCard(&face);
+        renderf("\n");
+    }
+
+    if (game->undoLog != NULL) {
+        recordChange(game, CHANGE_PLAY, player, card, 0);
+    }
+    // Remove played card from player's hand
+    removeCardFromHand(player, card);
+    inferPlay(&player->hand, card);
+    // Put the card on top of the pile
+    game->discardPile->cards[game->discardPile->count++] = card;
+    game->discardCounts[card]++;
+    game->activeColor = face.color == SPECIAL ? color : face.color;
+    game->drawnCard = -1;
+    if (game->events != NULL) {
+        publishEvent(game, EVENT_CARD_PLAYED, player->seat, card, SPECIAL);
+        if (face.color == SPECIAL) {
+            publishEvent(game, EVENT_COLOR_CHOSEN, player->seat, NO_CARD, color);
+        }
+    }
+
+    if (player->hand.size == 0) {
+        game->winner = player;
+        if (game->events != NULL) {
+            publishEvent(game, EVENT_GAME_WON, player->seat, NO_CARD, SPECIAL);
+        }
+        return;
+    }
+
+    // handle special cards
+    switch (face.type) {
+        case SKIP:
+            SkipTurn(game);
+            break;
+        case REVERSE:
+            TELEMETRY_COUNT(TELEMETRY_REVERSES, 1);
+            reverseDirection(game);
+            break;
+        case WILD_DRAW:
+            if (rules & RULE_STACKING) {
+                game->pendingDraw += 4;
+                break;
+            }
+            WildDraw(game, playerAfter(game, player, 1));
+            SkipTurn(game);
+            break;
+        case DRAW_TWO:
+            if (rules & RULE_STACKING) {
+                game->pendingDraw += 2;
+                break;
+            }
+            Draw_Two(game, playerAfter(game, player, 1));
+            SkipTurn(game);
+            break;
+        case SEVEN:
+            if (rules & RULE_SEVEN_ZERO) {
+                playSeven(game, player);
+            }
+            break;
+        case ZERO:
+            if (rules & RULE_SEVEN_ZERO) {
+                playZero(game, player);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Function to find a player who can jump in on a card: the first one after the player who played it,
+// in the direction of play, holding the same card. Wilds cannot be jumped on.
+static struct Player* findJumpIn(struct Game* game, struct Player* player, unsigned char card) {
+    if (cardColor(card) == SPECIAL) {
+        return NULL;
+    }
+    for (int steps = 1; steps < game->numPlayers; steps++) {
+        struct Player* other = playerAfter(game, player, steps);
+        if (other->hand.counts[card] != 0) {
+            return other;
+        }
+    }
+    return NULL;
+}
+
+static void logByte(struct GameLog* log, unsigned char value);
+static void logMove(struct Game* game, const struct Move* move);
+
+// Function to draw the card of a draw move under a rule set: one card, or with RULE_DRAW_UNTIL_PLAYABLE
+// cards until one can be played. Returns the last card drawn, -1 when none could be drawn.
+ENGINE int drawWithRules(struct Game* game, struct Player* player, const unsigned int rules) {
+    int last = -1;
+    int card;
+    do {
+        card = drawCard(game, player);
+        if (card < 0) {
+            break;
+        }
+        last = card;
+        if (game->verbose) {
+            renderf("Player %s drew a card.\n", player->name);
+            displayLastCard(card);
+        }
+    } while ((rules & RULE_DRAW_UNTIL_PLAYABLE) && !(currentPlayableMask(game) & CARD_BIT(card)));
+    return last;
+}
+
+// Function to apply a move for the current player under a rule set
+ENGINE void applyMoveWithRules(struct Game* game, const struct Move* move, const unsigned int rules) {
+    struct Player* player = game->currentPlayer;
+    if (game->log != NULL) {
+        logMove(game, move);
+    }
+
+    switch (move->kind) {
+        case MOVE_DRAW: {
+            int held = player->hand.size;
+            if ((rules & RULE_STACKING) && game->pendingDraw > 0) {
+                // Take the stacked draw and lose the turn. The player had nothing to stack, and the
+                // cards drawn tell nothing.
+                unsigned char top = game->discardPile->cards[game->discardPile->count - 1];
+                if (game->undoLog != NULL) {
+                    recordChange(game, CHANGE_EVIDENCE, player, 0, 0);
+                }
+                inferDraw(&player->hand, CARD_BIT(CARD(SPECIAL, 1)) | (cardType(top) == DRAW_TWO ? TYPE_MASK(DRAW_TWO) : 0),
+                          held, 0);
+                if (game->verbose) {
+                    renderf("Player %s draws %d cards.\n", player->name, game->pendingDraw);
+                }
+                int last = -1;
+                for (; game->pendingDraw > 0; game->pendingDraw--) {
+                    int card = drawCard(game, player);
+                    last = card >= 0 ? card : last;
+                }
+                if (game->log != NULL) {
+                    logByte(game->log, LOG_DRAW | (last < 0 ? LOG_NO_CARD : last));
+                }
+                break;
+            }
+            unsigned long long playable = compatibleCards[game->discardPile->cards[game->discardPile->count - 1]][game->activeColor];
+            int card = drawWithRules(game, player, rules);
+            if (game->log != NULL) {
+                logByte(game->log, LOG_DRAW | (card < 0 ? LOG_NO_CARD : card));
+            }
+            // Every card drawn but a playable last one is known not to be playable
+            int drawn = player->hand.size - held;
+            if (game->undoLog != NULL) {
+                recordChange(game, CHANGE_EVIDENCE, player, 0, 0);
+            }
+            inferDraw(&player->hand, playable, held, drawn - (card >= 0 && (playable & CARD_BIT(card)) ? 1 : 0));
+            if (card < 0) {
+                if (game->verbose) {
+                    renderf("No cards left to draw.\n");
+                }
+                break;
+            }
+            // A playable card may still be played this turn
+            if (currentPlayableMask(game) & CARD_BIT(card)) {
+                game->drawnCard = card;
+                return;
+            }
+            if (game->verbose) {
+                renderf("Card is not playable.\n");
+            }
+            break;
+        }
+        case MOVE_PASS:
+            game->drawnCard = -1;
+            break;
+        case MOVE_PLAY:
+            playCardWithRules(game, move->card, move->color, rules);
+            // Other players holding the same card may jump in, and play goes on from them
+            struct Player* jumper;
+            while ((rules & RULE_JUMP_IN) && game->winner == NULL && (jumper = findJumpIn(game, player, move->card)) != NULL) {
+                if (game->verbose) {
+                    renderf("Player %s jumps in!\n", jumper->name);
+                }
+                game->currentPlayer = player = jumper;
+                playCardWithRules(game, move->card, move->color, rules);
+            }
+            if (game->winner != NULL) {
+                return;
+            }
+            break;
+    }
+
+    // Move to the next player
+    game->currentPlayer = playerAfter(game, game->currentPlayer, 1);
+    game->turns++;
+}
+
+// Specialized engines, one per rule set
+#define RULE_ENGINE(rules) \
+    static int listLegalMoves##rules(struct Game* game, struct Move* moves) { \
+        return listMovesWithRules(game, moves, rules); \
+    } \
+    static void applyMove##rules(struct Game* game, const struct Move* move) { \
+        applyMoveWithRules(game, move, rules); \
+    }
+RULE_ENGINE(1) RULE_ENGINE(2) RULE_ENGINE(3) RULE_ENGINE(4) RULE_ENGINE(5) RULE_ENGINE(6) RULE_ENGINE(7)
+RULE_ENGINE(8) RULE_ENGINE(9) RULE_ENGINE(10) RULE_ENGINE(11) RULE_ENGINE(12) RULE_ENGINE(13) RULE_ENGINE(14)
+RULE_ENGINE(15) RULE_ENGINE(16) RULE_ENGINE(17) RULE_ENGINE(18) RULE_ENGINE(19) RULE_ENGINE(20) RULE_ENGINE(21)
+RULE_ENGINE(22) RULE_ENGINE(23) RULE_ENGINE(24) RULE_ENGINE(25) RULE_ENGINE(26) RULE_ENGINE(27) RULE_ENGINE(28)
+RULE_ENGINE(29) RULE_ENGINE(30) RULE_ENGINE(31)
+
+// Define the turn engine of one rule set
+struct RuleEngine {
+    int (*listLegalMoves)(struct Game* game, struct Move* moves);
+    void (*applyMove)(struct Game* game, const struct Move* move);
+};
+
+#define ENGINE_ENTRY(rules) { listLegalMoves##rules, applyMove##rules }
+static const struct RuleEngine ruleEngines[NUM_RULE_SETS] = {
+    { NULL, NULL }, ENGINE_ENTRY(1), ENGINE_ENTRY(2), ENGINE_ENTRY(3), ENGINE_ENTRY(4), ENGINE_ENTRY(5),
+    ENGINE_ENTRY(6), ENGINE_ENTRY(7), ENGINE_ENTRY(8), ENGINE_ENTRY(9), ENGINE_ENTRY(10), ENGINE_ENTRY(11),
+    ENGINE_ENTRY(12), ENGINE_ENTRY(13), ENGINE_ENTRY(14), ENGINE_ENTRY(15), ENGINE_ENTRY(16), ENGINE_ENTRY(17),
+    ENGINE_ENTRY(18), ENGINE_ENTRY(19), ENGINE_ENTRY(20), ENGINE_ENTRY(21), ENGINE_ENTRY(22), ENGINE_ENTRY(23),
+    ENGINE_ENTRY(24), ENGINE_ENTRY(25), ENGINE_ENTRY(26), ENGINE_ENTRY(27), ENGINE_ENTRY(28), ENGINE_ENTRY(29),
+    ENGINE_ENTRY(30), ENGINE_ENTRY(31)
+};
+
+// Function to list the legal moves of the current player, returns the number of moves.
+// The standard rules are inlined here, other rule sets call their own engine.
+int listLegalMoves(struct Game* game, struct Move* moves) {
+    if (game->rules == 0) {
+        return listMovesWithRules(game, moves, 0);
+    }
+    return ruleEngines[game->rules].listLegalMoves(game, moves);
+}
+
+// Function to apply a move for the current player
+void applyMove(struct Game* game, const struct Move* move) {
+    if (game->rules == 0) {
+        applyMoveWithRules(game, move, 0);
+    } else {
+        ruleEngines[game->rules].applyMove(game, move);
+    }
+}
+
+// Make and unmake: search tries a move on the game itself and takes it back, instead of copying the
+// game. While makeMove applies a move, the engine journals each card it moves and what it knew of the
+// hands; the rest of the state fits in the undo entry. Taking a move back walks its changes backwards,
+// so it costs one step per card the move touched and never looks at the rest of the game.
+
+// Function to set up an empty undo log, its buffer grows as needed and is reused from move to move
+void initUndoLog(struct UndoLog* log) {
+    log->capacity = 256;
+    log->changes = (struct Change*)malloc(log->capacity * sizeof(struct Change));
+    log->numChanges = 0;
+}
+
+// Function to release the buffer of an undo log
+void freeUndoLog(struct UndoLog* log) {
+    free(log->changes);
+}
+
+// Function to apply a move for the current player so that unmakeMove can take it back.
+// The game must not be logged: what was written to a replay log stays there.
+void makeMove(struct Game* game, const struct Move* move, struct UndoLog* log, struct Undo* undo) {
+    *undo = (struct Undo){ game->rng, log->numChanges, game->currentPlayer->seat, game->direction, game->drawnCard,
+                           game->winner != NULL ? game->winner->seat : -1, game->turns, game->pendingDraw,
+                           game->activeColor };
+    game->undoLog = log;
+    applyMove(game, move);
+    game->undoLog = NULL;
+}
+
+// Function to take back a move made by makeMove, along with every move made after it
+void unmakeMove(struct Game* game, struct UndoLog* log, const struct Undo* undo) {
+    while (log->numChanges > undo->firstChange) {
+        const struct Change* change = &log->changes[--log->numChanges];
+        struct Player* player = &game->seats[change->seat];
+        switch (change->kind) {
+            case CHANGE_DRAW: {
+                // The card that filled the slot is still past the end of the deck
+                struct Deck* deck = game->deck;
+                removeCardFromHand(player, change->card);
+                deck->cards[deck->count++] = deck->cards[change->slot];
+                deck->cards[change->slot] = change->card;
+                break;
+            }
+            case CHANGE_RECYCLE: {
+                // The top card goes back on the buried cards and the other pile was empty. The discard
+                // pile is counted again, which only happens once per recycle.
+                struct Deck* discardPile = game->deck;
+                discardPile->cards[discardPile->count++] = change->card;
+                game->deck = game->discardPile;
+                game->deck->count = 0;
+                game->discardPile = discardPile;
+                memset(game->discardCounts, 0, sizeof(game->discardCounts));
+                for (int i = 0; i < discardPile->count; i++) {
+                    game->discardCounts[discardPile->cards[i]]++;
+                }
+                break;
+            }
+            case CHANGE_PLAY:
+                game->discardPile->count--;
+                game->discardCounts[change->card]--;
+                addCardToHand(&player->hand, change->card);
+                player->hand.excluded = change->excluded;
+                player->hand.constrained = change->constrained;
+                break;
+            case CHANGE_EVIDENCE:
+                player->hand.excluded = change->excluded;
+                player->hand.constrained = change->constrained;
+                break;
+            case CHANGE_SWAP:
+                swapHands(player, &game->seats[change->slot]);
+                break;
+            case CHANGE_PASS:
+                passHands(game, -change->slot);
+                break;
+        }
+    }
+    game->rng = undo->rng;
+    game->currentPlayer = &game->seats[undo->currentSeat];
+    game->direction = undo->direction;
+    game->drawnCard = undo->drawnCard;
+    game->winner = undo->winnerSeat < 0 ? NULL : &game->seats[undo->winnerSeat];
+    game->turns = undo->turns;
+    game->pendingDraw = undo->pendingDraw;
+    game->activeColor = undo->activeColor;
+}
+
+// Function to check that a move is one of the legal moves of the current player
+static bool isLegalMove(struct Game* game, const struct Move* move) {
+    struct Move moves[MAX_MOVES];
+    int numMoves = listLegalMoves(game, moves);
+    for (int i = 0; i < numMoves; i++) {
+        if (moves[i].kind == move->kind && (move->kind != MOVE_PLAY || moves[i].card == move->card)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to get the winner of the game, NULL while the game is still running
+struct Player* getWinner(struct Game* game) {
+    return game->winner;
+}
+
+// Function to deallocate everything owned by a game
+void freeGame(struct Game* game) {
+    struct Arena arena = game->arena;
+    arenaRelease(&arena);
+}
+
+// Function to find in a copy of a game what is at the same place of the block as in the original
+static void* rebasePointer(const struct Game* game, struct Game* copy, const void* pointer) {
+    if (pointer == NULL) {
+        return NULL;
+    }
+    return copy->arena.block + ((const unsigned char*)pointer - game->arena.block);
+}
+
+// Function to copy a game over another game with the same number of players, reusing its block.
+// The game lives at the start of its block, so the copy is one memcpy plus fixing the pointers.
+// The copy is never verbose nor logged.
+void copyGame(struct Game* copy, const struct Game* game) {
+    struct Arena arena = copy->arena;
+    memcpy(arena.block, game->arena.block, game->arena.used);
+    copy->arena = arena;
+    copy->deck = &copy->piles[game->deck - game->piles];
+    copy->discardPile = &copy->piles[game->discardPile - game->piles];
+    for (int i = 0; i < 2; i++) {
+        copy->piles[i].cards = (unsigned char*)rebasePointer(game, copy, game->piles[i].cards);
+    }
+    copy->seats = (struct Player*)rebasePointer(game, copy, game->seats);
+    copy->currentPlayer = (struct Player*)rebasePointer(game, copy, game->currentPlayer);
+    copy->winner = (struct Player*)rebasePointer(game, copy, game->winner);
+    for (int seat = 0; seat < game->numPlayers; seat++) {
+        copy->seats[seat].name = (char*)rebasePointer(game, copy, game->seats[seat].name);
+    }
+    copy->verbose = false;
+    copy->log = NULL;
+    copy->undoLog = NULL;
+    copy->events = NULL;
+}
+
+// Function to make a copy of a game in a block of its own, released with freeGame
+struct Game* cloneGame(const struct Game* game) {
+    struct Arena arena;
+    arenaInit(&arena, game->arena.capacity);
+    arena.used = game->arena.used;
+    struct Game* copy = (struct Game*)arena.block;
+    copy->arena = arena;
+    copyGame(copy, game);
+    return copy;
+}
+
+// Function to pick one of the unseen cards, each card as likely as its weight: BELIEF_WEIGHT, or the
+// doubt weight for the excluded card ids. Returns -1 when every card left is ruled out.
+static int pickUnseenCard(const int* unseen, unsigned long long pool, int count, unsigned long long excluded,
+                          int doubt, struct Rng* rng) {
+    excluded &= pool;
+    unsigned int total = count * BELIEF_WEIGHT;
+    for (unsigned long long mask = excluded; mask != 0; mask &= mask - 1) {
+        total -= unseen[__builtin_ctzll(mask)] * (BELIEF_WEIGHT - doubt);
+    }
+    if (total == 0) {
+        return -1;
+    }
+    unsigned int target = rngBounded(rng, total);
+    for (unsigned long long mask = pool; ; mask &= mask - 1) {
+        int card = __builtin_ctzll(mask);
+        unsigned int weight = unseen[card] * ((excluded & CARD_BIT(card)) ? doubt : BELIEF_WEIGHT);
+        if (target < weight) {
+            return card;
+        }
+        target -= weight;
+    }
+}
+
+// Function to replace what a player cannot see with one possible deal: the cards of the deck and of
+// the other hands are dealt back at random, every hand keeping its size. The cards a hand is believed
+// not to hold are less likely in it (never, when the rules prove it), so the hands with evidence are
+// dealt first, while they have the most cards to choose from.
+void determinize(struct Game* game, int observer, struct Rng* rng) {
+    int unseen[NUM_CARD_IDS] = { 0 };
+    unsigned long long pool = 0;
+    struct Deck* deck = game->deck;
+    for (int i = 0; i < deck->count; i++) {
+        unseen[deck->cards[i]]++;
+        pool |= CARD_BIT(deck->cards[i]);
+    }
+    int count = deck->count;
+    for (int seat = 0; seat < game->numPlayers; seat++) {
+        struct Hand* hand = &game->seats[seat].hand;
+        if (seat == observer) {
+            continue;
+        }
+        for (unsigned long long mask = hand->mask; mask != 0; mask &= mask - 1) {
+            unsigned char card = __builtin_ctzll(mask);
+            unseen[card] += hand->counts[card];
+        }
+        pool |= hand->mask;
+        count += hand->size;
+    }
+
+    int doubt = doubtWeight(game->rules);
+    for (int pass = 0; pass < 2; pass++) {
+        for (int seat = 0; seat < game->numPlayers; seat++) {
+            struct Hand* hand = &game->seats[seat].hand;
+            if (seat == observer || (hand->constrained > 0) != (pass == 0)) {
+                continue;
+            }
+            struct Hand held = *hand;
+            memset(hand, 0, sizeof(*hand));
+            hand->excluded = held.excluded;
+            hand->constrained = held.constrained;
+            for (int i = 0; i < held.size; i++) {
+                int card = pickUnseenCard(unseen, pool, count, i < held.constrained ? held.excluded : 0, doubt, rng);
+                if (card < 0) {
+                    // The deals made so far left nothing the evidence allows
+                    card = pickUnseenCard(unseen, pool, count, 0, doubt, rng);
+                }
+                addCardToHand(hand, card);
+                if (--unseen[card] == 0) {
+                    pool &= ~CARD_BIT(card);
+                }
+                count--;
+            }
+        }
+    }
+    // The cards left make the deck, which is drawn from at random so its order does not matter
+    deck->count = 0;
+    for (unsigned long long mask = pool; mask != 0; mask &= mask - 1) {
+        unsigned char card = __builtin_ctzll(mask);
+        memset(deck->cards + deck->count, card, unseen[card]);
+        deck->count += unseen[card];
+    }
+    // Later draws must not be known in advance either
+    rngSeed(&game->rng, rngNext(rng));
+}
+
+// Function to get the chance, as the observer sees it, that a seat holds at least one card among a set
+// of card ids. Each hidden card counts as one pick among the unseen cards, weighted as determinize does.
+// The unseen cards follow from the counts of the discard pile, so this takes no look at the history.
+double holdProbability(const struct Game* game, int observer, int seat, unsigned long long cards) {
+    const struct Hand* hand = &game->seats[seat].hand;
+    if (seat == observer) {
+        return (hand->mask & cards) != 0;
+    }
+    const struct Hand* own = &game->seats[observer].hand;
+    int numDecks = decksForPlayers(game->numPlayers);
+    double total = numDecks * DECK_SIZE - game->discardPile->count - own->size;
+    double inside = 0;         // Unseen cards in the set
+    double excludedInside = 0; // Unseen cards in the set the evidence excludes
+    double excluded = 0;       // Unseen cards the evidence excludes
+    for (unsigned long long mask = cards | hand->excluded; mask != 0; mask &= mask - 1) {
+        int card = __builtin_ctzll(mask);
+        int copies = numDecks * cardCopies(card) - game->discardCounts[card] - own->counts[card];
+        bool isExcluded = (hand->excluded & CARD_BIT(card)) != 0;
+        if (cards & CARD_BIT(card)) {
+            inside += copies;
+            excludedInside += isExcluded ? copies : 0;
+        }
+        excluded += isExcluded ? copies : 0;
+    }
+    if (total <= 0) {
+        return 0;
+    }
+    int doubt = doubtWeight(game->rules);
+    double anyCard = inside / total;
+    double weighted = BELIEF_WEIGHT * (total - excluded) + doubt * excluded;
+    double coveredCard = weighted > 0
+                       ? (BELIEF_WEIGHT * (inside - excludedInside) + doubt * excludedInside) / weighted : anyCard;
+    return 1 - pow(1 - anyCard, hand->size - hand->constrained) * pow(1 - coveredCard, hand->constrained);
+}
+
+
+// Snapshot layout (version 3), all numbers little-endian, every card one byte (its id):
+//   "UNOS", version, player count, current seat, reversed flag, active color,
+//   drawn card (0xFF for none), winner seat (0xFF for none), house rules, pending draw, turns (4 bytes),
+//   generator state (32 bytes), deck count and cards (bottom first),
+//   discard count and cards (bottom first), then for each seat:
+//   name length and name, hand size and cards, then what the others inferred of the hand (see
+//   inferDraw): the number of its cards the evidence covers and the mask of excluded card ids (8 bytes)
+
+// Function to write a game into a buffer, returns the snapshot size or 0 if the buffer is too small
+size_t saveGame(const struct Game* game, unsigned char* buffer, size_t capacity) {
+    if (capacity < SNAPSHOT_MAX_SIZE || game->numPlayers > MAX_PLAYERS) {
+        return 0;
+    }
+    unsigned char* out = buffer;
+    memcpy(out, "UNOS", 4);
+    out += 4;
+    *out++ = SNAPSHOT_VERSION;
+    *out++ = game->numPlayers;
+    *out++ = game->currentPlayer->seat;
+    *out++ = game->direction < 0;
+    *out++ = game->activeColor;
+    *out++ = game->drawnCard < 0 ? 0xFF : game->drawnCard;
+    *out++ = game->winner == NULL ? 0xFF : game->winner->seat;
+    *out++ = game->rules;
+    *out++ = game->pendingDraw;
+    for (int i = 0; i < 4; i++) {
+        *out++ = (unsigned char)(game->turns >> (8 * i));
+    }
+    for (int k = 0; k < 4; k++) {
+        for (int i = 0; i < 8; i++) {
+            *out++ = (unsigned char)(game->rng.s[k] >> (8 * i));
+        }
+    }
+    *out++ = game->deck->count;
+    memcpy(out, game->deck->cards, game->deck->count);
+    out += game->deck->count;
+    *out++ = game->discardPile->count;
+    memcpy(out, game->discardPile->cards, game->discardPile->count);
+    out += game->discardPile->count;
+    for (int seat = 0; seat < game->numPlayers; seat++) {
+        const struct Player* player = &game->seats[seat];
+        size_t length = strlen(player->name);
+        if (length > SNAPSHOT_MAX_NAME) {
+            length = SNAPSHOT_MAX_NAME;
+        }
+        *out++ = (unsigned char)length;
+        memcpy(out, player->name, length);
+        out += length;
+        *out++ = player->hand.size;
+        for (unsigned long long mask = player->hand.mask; mask != 0; mask &= mask - 1) {
+            unsigned char card = __builtin_ctzll(mask);
+            memset(out, card, player->hand.counts[card]);
+            out += player->hand.counts[card];
+        }
+        *out++ = player->hand.constrained;
+        for (int i = 0; i < 8; i++) {
+            *out++ = (unsigned char)(player->hand.excluded >> (8 * i));
+        }
+    }
+    return out - buffer;
+}
+
+// Function to read a run of card ids from a snapshot, counting them against the full deck
+static const unsigned char* loadCards(const unsigned char* in, const unsigned char* end, int count,
+                                      unsigned char* cards, int* remaining) {
+    if (in == NULL || count > end - in) {
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        if (in[i] >= NUM_CARD_IDS || remaining[in[i]]-- == 0) {
+            return NULL;
+        }
+        cards[i] = in[i];
+    }
+    return in + count;
+}
+
+// Function to rebuild a game from a snapshot, returns NULL if the snapshot is not valid
+struct Game* loadGame(const unsigned char* buffer, size_t size, bool verbose) {
+    const unsigned char* in = buffer;
+    const unsigned char* end = buffer + size;
+    if (size < 4 + 9 + 4 + 32 + 1 || memcmp(in, "UNOS", 4) != 0 || in[4] != SNAPSHOT_VERSION) {
+        return NULL;
+    }
+    in += 5;
+    int numPlayers = *in++;
+    int currentSeat = *in++;
+    bool reversed = *in++;
+    int activeColor = *in++;
+    int drawnCard = *in++;
+    int winnerSeat = *in++;
+    unsigned int rules = *in++;
+    int pendingDraw = *in++;
+    if (numPlayers < 2 || numPlayers > MAX_PLAYERS || currentSeat >= numPlayers || activeColor >= SPECIAL
+        || (drawnCard != 0xFF && drawnCard >= NUM_CARD_IDS) || (winnerSeat != 0xFF && winnerSeat >= numPlayers)
+        || rules >= NUM_RULE_SETS) {
+        return NULL;
+    }
+    int turns = 0;
+    for (int i = 0; i < 4; i++) {
+        turns |= *in++ << (8 * i);
+    }
+    struct Rng rng;
+    for (int k = 0; k < 4; k++) {
+        rng.s[k] = 0;
+        for (int i = 0; i < 8; i++) {
+            rng.s[k] |= (unsigned long long)*in++ << (8 * i);
+        }
+    }
+
+    // Every card of the deck must appear exactly once
+    int remaining[NUM_CARD_IDS] = { 0 };
+    for (int i = 0; i < DECK_SIZE; i++) {
+        remaining[canonicalDeck[i]]++;
+    }
+    unsigned char deckCards[DECK_SIZE];
+    unsigned char discardCards[DECK_SIZE];
+    struct Deck deck = { deckCards, 0 };
+    struct Deck discardPile = { discardCards, 0 };
+    deck.count = *in++;
+    in = loadCards(in, end, deck.count, deck.cards, remaining);
+    if (in == NULL || in >= end) {
+        return NULL;
+    }
+    discardPile.count = *in++;
+    in = loadCards(in, end, discardPile.count, discardPile.cards, remaining);
+    if (in == NULL || discardPile.count == 0) {
+        return NULL;
+    }
+
+    char names[MAX_PLAYERS][SNAPSHOT_MAX_NAME + 1];
+    const char* namePointers[MAX_PLAYERS];
+    struct Hand hands[MAX_PLAYERS];
+    for (int seat = 0; seat < numPlayers; seat++) {
+        if (in >= end || *in + 1 > end - in - 1) {
+            return NULL;
+        }
+        int length = *in++;
+        memcpy(names[seat], in, length);
+        names[seat][length] = '\0';
+        namePointers[seat] = names[seat];
+        in += length;
+        unsigned char cards[DECK_SIZE];
+        int handSize = *in++;
+        in = loadCards(in, end, handSize, cards, remaining);
+        if (in == NULL || end - in < 9 || *in > handSize) {
+            return NULL;
+        }
+        memset(&hands[seat], 0, sizeof(hands[seat]));
+        for (int i = 0; i < handSize; i++) {
+            addCardToHand(&hands[seat], cards[i]);
+        }
+        hands[seat].constrained = *in++;
+        for (int i = 0; i < 8; i++) {
+            hands[seat].excluded |= (unsigned long long)*in++ << (8 * i);
+        }
+        if (hands[seat].excluded >> NUM_CARD_IDS) {
+            return NULL;
+        }
+    }
+    for (int card = 0; card < NUM_CARD_IDS; card++) {
+        if (remaining[card] != 0) {
+            return NULL;
+        }
+    }
+    // The drawn card must be in the current hand, and a stacked draw only exists under RULE_STACKING,
+    // made of the Draw Two and Wild Draw Four cards on top of the discard pile
+    int stacked = 0;
+    for (int i = discardPile.count - 1; i >= 0; i--) {
+        enum Type type = cardType(discardPile.cards[i]);
+        if (type != DRAW_TWO && type != WILD_DRAW) {
+            break;
+        }
+        stacked += type == DRAW_TWO ? 2 : 4;
+    }
+    if ((drawnCard != 0xFF && hands[currentSeat].counts[drawnCard] == 0)
+        || (pendingDraw != 0 && !(rules & RULE_STACKING)) || pendingDraw > stacked) {
+        return NULL;
+    }
+
+    struct Game* game = allocGame(namePointers, numPlayers, verbose);
+    for (int seat = 0; seat < numPlayers; seat++) {
+        game->seats[seat].hand = hands[seat];
+    }
+    game->direction = reversed ? -1 : 1;
+    game->currentPlayer = &game->seats[currentSeat];
+    game->activeColor = activeColor;
+    game->drawnCard = drawnCard == 0xFF ? -1 : drawnCard;
+    game->winner = winnerSeat == 0xFF ? NULL : &game->seats[winnerSeat];
+    game->turns = turns;
+    game->rules = rules;
+    game->pendingDraw = pendingDraw;
+    game->rng = rng;
+    memcpy(game->deck->cards, deck.cards, deck.count);
+    game->deck->count = deck.count;
+    memcpy(game->discardPile->cards, discardPile.cards, discardPile.count);
+    game->discardPile->count = discardPile.count;
+    for (int i = 0; i < discardPile.count; i++) {
+        game->discardCounts[discardPile.cards[i]]++;
+    }
+    return game;
+}
+
+// Function to save a game to a file
+bool saveGameToFile(const struct Game* game, const char* path) {
+    unsigned char buffer[SNAPSHOT_MAX_SIZE];
+    size_t size = saveGame(game, buffer, sizeof(buffer));
+    if (size == 0) {
+        return false;
+    }
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    bool written = fwrite(buffer, 1, size, file) == size;
+    return fclose(file) == 0 && written;
+}
+
+// Function to load a game saved with saveGameToFile, returns NULL if it cannot be read
+struct Game* loadGameFromFile(const char* path, bool verbose) {
+    unsigned char buffer[SNAPSHOT_MAX_SIZE];
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    size_t size = fread(buffer, 1, sizeof(buffer), file);
+    fclose(file);
+    return loadGame(buffer, size, verbose);
+}
+
+// Function to write a number into bytes, least significant byte first
+static void putLittleEndian(unsigned char* out, unsigned long long value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+// Function to read a number written by putLittleEndian
+static unsigned long long getLittleEndian(const unsigned char* in, int bytes) {
+    unsigned long long value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= (unsigned long long)in[i] << (8 * i);
+    }
+    return value;
+}
+
+// Function to open a replay log for appending, returns NULL if the file cannot be opened or already
+// holds something other than a replay log of this version
+struct LogWriter* openLogWriter(const char* path) {
+    FILE* file = fopen(path, "a+b");
+    if (file == NULL) {
+        return NULL;
+    }
+    // Games are only appended after the header of the same version, readers would reject the file
+    unsigned char header[5];
+    size_t headerSize = fread(header, 1, sizeof(header), file);
+    if (headerSize > 0 && (headerSize < sizeof(header) || memcmp(header, "UNOL", 4) != 0 || header[4] != LOG_VERSION)) {
+        fclose(file);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    struct LogWriter* writer = (struct LogWriter*)malloc(sizeof(struct LogWriter));
+    writer->file = file;
+    writer->buffer = (unsigned char*)malloc(LOG_BUFFER_SIZE);
+    writer->used = 0;
+    pthread_mutex_init(&writer->lock, NULL);
+    // A new log starts with its magic and version
+    if (ftell(file) == 0) {
+        memcpy(writer->buffer, "UNOL", 4);
+        writer->buffer[4] = LOG_VERSION;
+        writer->used = 5;
+    }
+    return writer;
+}
+
+// Function to write out everything buffered and close a replay log
+void closeLogWriter(struct LogWriter* writer) {
+    fwrite(writer->buffer, 1, writer->used, writer->file);
+    fclose(writer->file);
+    pthread_mutex_destroy(&writer->lock);
+    free(writer->buffer);
+    free(writer);
+}
+
+// Function to append a finished game to the log, writing the file only when the buffer fills up
+static void writeLoggedGame(struct LogWriter* writer, const unsigned char* bytes, size_t size) {
+    pthread_mutex_lock(&writer->lock);
+    if (writer->used + size > LOG_BUFFER_SIZE) {
+        fwrite(writer->buffer, 1, writer->used, writer->file);
+        writer->used = 0;
+    }
+    if (size > LOG_BUFFER_SIZE) {
+        fwrite(bytes, 1, size, writer->file);
+    } else {
+        memcpy(writer->buffer + writer->used, bytes, size);
+        writer->used += size;
+    }
+    pthread_mutex_unlock(&writer->lock);
+}
+
+// Function to set up the records of a game log, the buffers are reused from game to game
+void initGameLog(struct GameLog* log, struct LogWriter* writer) {
+    log->writer = writer;
+    log->capacity = 4096;
+    log->bytes = (unsigned char*)malloc(log->capacity);
+    log->used = 0;
+    log->checkpointCapacity = 64;
+    log->checkpoints = (unsigned int*)malloc(2 * log->checkpointCapacity * sizeof(unsigned int));
+    log->numCheckpoints = 0;
+}
+
+// Function to release the buffers of a game log
+void freeGameLog(struct GameLog* log) {
+    free(log->bytes);
+    free(log->checkpoints);
+}
+
+// Function to make room for more records in a game log
+static unsigned char* logSpace(struct GameLog* log, size_t size) {
+    if (log->used + size > log->capacity) {
+        while (log->used + size > log->capacity) {
+            log->capacity *= 2;
+        }
+        log->bytes = (unsigned char*)realloc(log->bytes, log->capacity);
+    }
+    unsigned char* space = log->bytes + log->used;
+    log->used += size;
+    return space;
+}
+
+// Function to add a one-byte record to a game log
+static void logByte(struct GameLog* log, unsigned char value) {
+    *logSpace(log, 1) = value;
+}
+
+// Function to add a checkpoint of the current state to a game log and index it
+static void logCheckpoint(struct GameLog* log, struct Game* game) {
+    if (log->numCheckpoints == log->checkpointCapacity) {
+        log->checkpointCapacity *= 2;
+        log->checkpoints = (unsigned int*)realloc(log->checkpoints,
+                                                  2 * log->checkpointCapacity * sizeof(unsigned int));
+    }
+    log->checkpoints[2 * log->numCheckpoints] = game->turns;
+    log->checkpoints[2 * log->numCheckpoints + 1] = (unsigned int)log->used;
+    log->numCheckpoints++;
+
+    unsigned char snapshot[SNAPSHOT_MAX_SIZE];
+    size_t size = saveGame(game, snapshot, sizeof(snapshot));
+    unsigned char* out = logSpace(log, 7 + size);
+    out[0] = LOG_CHECKPOINT;
+    putLittleEndian(out + 1, game->turns, 4);
+    putLittleEndian(out + 5, size, 2);
+    memcpy(out + 7, snapshot, size);
+}
+
+// Function to start logging a game: header with the seed and the players, then a first checkpoint
+void beginGameLog(struct GameLog* log, struct Game* game, unsigned long long seed) {
+    log->used = 0;
+    log->numCheckpoints = 0;
+    game->log = log;
+
+    unsigned char* out = logSpace(log, 10);
+    out[0] = LOG_GAME;
+    putLittleEndian(out + 1, seed, 8);
+    out[9] = game->numPlayers;
+    for (int seat = 0; seat < game->numPlayers; seat++) {
+        size_t length = strlen(game->seats[seat].name);
+        if (length > SNAPSHOT_MAX_NAME) {
+            length = SNAPSHOT_MAX_NAME;
+        }
+        out = logSpace(log, 1 + length);
+        out[0] = (unsigned char)length;
+        memcpy(out + 1, game->seats[seat].name, length);
+    }
+    logCheckpoint(log, game);
+}
+
+// Function to log the move about to be applied, with a checkpoint every LOG_CHECKPOINT_INTERVAL turns
+static void logMove(struct Game* game, const struct Move* move) {
+    struct GameLog* log = game->log;
+    unsigned int lastCheckpoint = log->checkpoints[2 * (log->numCheckpoints - 1)];
+    if (game->drawnCard < 0 && game->turns % LOG_CHECKPOINT_INTERVAL == 0 && (unsigned int)game->turns > lastCheckpoint) {
+        logCheckpoint(log, game);
+    }
+    if (move->kind == MOVE_PLAY) {
+        logByte(log, LOG_PLAY | move->card);
+        if (cardColor(move->card) == SPECIAL) {
+            logByte(log, LOG_COLOR | move->color);
+        }
+    } else if (move->kind == MOVE_PASS) {
+        logByte(log, LOG_PASS);
+    }
+    // Draws are logged with the card once it is drawn
+}
+
+// Function to finish logging a game: result, checkpoint index and trailer, then append it to the file.
+// The index is the turn and offset of every checkpoint, followed by their count; the trailer is the
+// length of the whole game and "UIDX", so readers can walk a log from its end.
+void endGameLog(struct Game* game) {
+    struct GameLog* log = game->log;
+    unsigned char* out = logSpace(log, 6);
+    out[0] = LOG_END;
+    out[1] = game->winner == NULL ? 0xFF : game->winner->seat;
+    putLittleEndian(out + 2, game->turns, 4);
+    out = logSpace(log, 8 * log->numCheckpoints + 2 + 8);
+    for (int i = 0; i < log->numCheckpoints; i++) {
+        putLittleEndian(out, log->checkpoints[2 * i], 4);
+        putLittleEndian(out + 4, log->checkpoints[2 * i + 1], 4);
+        out += 8;
+    }
+    putLittleEndian(out, log->numCheckpoints, 2);
+    putLittleEndian(out + 2, log->used, 4);
+    memcpy(out + 6, "UIDX", 4);
+    writeLoggedGame(log->writer, log->bytes, log->used);
+    game->log = NULL;
+}
+
+// Define a replay log mapped into memory
+struct LogFile {
+    const unsigned char* data;
+    size_t size;
+    size_t* gameStarts;          // Offset of every game, in the order they were written
+    long numGames;
+};
+
+// Function to map a replay log and find its games by walking the trailers back from the end
+static bool openLogFile(const char* path, struct LogFile* log) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < 5) {
+        close(fd);
+        return false;
+    }
+    log->size = info.st_size;
+    void* data = mmap(NULL, log->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    log->data = (const unsigned char*)data;
+    if (memcmp(log->data, "UNOL", 4) != 0 || log->data[4] != LOG_VERSION) {
+        munmap(data, log->size);
+        return false;
+    }
+
+    long capacity = 1024;
+    log->gameStarts = (size_t*)malloc(capacity * sizeof(size_t));
+    log->numGames = 0;
+    size_t end = log->size;
+    while (end > 5) {
+        if (end < 5 + 18 || memcmp(log->data + end - 4, "UIDX", 4) != 0) {
+            break;
+        }
+        size_t length = getLittleEndian(log->data + end - 8, 4);
+        if (length < 10 + 6 + 10 || length > end - 5) {
+            break;
+        }
+        if (log->numGames == capacity) {
+            capacity *= 2;
+            log->gameStarts = (size_t*)realloc(log->gameStarts, capacity * sizeof(size_t));
+        }
+        log->gameStarts[log->numGames++] = end - length;
+        end -= length;
+    }
+    // The walk found the games from last to first
+    for (long i = 0; i < log->numGames / 2; i++) {
+        size_t temp = log->gameStarts[i];
+        log->gameStarts[i] = log->gameStarts[log->numGames - 1 - i];
+        log->gameStarts[log->numGames - 1 - i] = temp;
+    }
+    return end == 5;
+}
+
+// Function to unmap a replay log
+static void closeLogFile(struct LogFile* log) {
+    munmap((void*)log->data, log->size);
+    free(log->gameStarts);
+}
+
+// Function to find the result record of a logged game from its trailer, with the number of checkpoints
+// it indexes. Returns NULL when the index does not fit between the game header and the trailer.
+static const unsigned char* findLoggedResult(const unsigned char* start, size_t length, int* numCheckpoints) {
+    *numCheckpoints = (int)getLittleEndian(start + length - 10, 2);
+    if (*numCheckpoints < 1 || 10 + 6 + 8 * (size_t)*numCheckpoints + 10 > length) {
+        return NULL;
+    }
+    return start + length - 10 - 8 * *numCheckpoints - 6;
+}
+
+// Function to show a logged game at the start of a turn, fast-forwarding from the closest checkpoint
+static int replayLoggedGame(const unsigned char* start, size_t length, long gameNumber, long turn) {
+    int numCheckpoints;
+    const unsigned char* result = findLoggedResult(start, length, &numCheckpoints);
+    if (result == NULL) {
+        fprintf(stderr, "Game %ld: checkpoint is damaged.\n", gameNumber);
+        return 1;
+    }
+    const unsigned char* index = result + 6;
+    unsigned long long seed = getLittleEndian(start + 1, 8);
+    int winnerSeat = result[1];
+    long totalTurns = (long)getLittleEndian(result + 2, 4);
+    bool toEnd = turn < 0 || turn >= totalTurns;
+    if (toEnd) {
+        turn = totalTurns;
+    }
+
+    // Binary search for the last checkpoint at or before the turn
+    int low = 0;
+    int high = numCheckpoints - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if ((long)getLittleEndian(index + 8 * middle, 4) <= turn) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    // The checkpoint and its snapshot must lie within the records of the game
+    size_t offset = getLittleEndian(index + 8 * low + 4, 4);
+    const unsigned char* in = start + offset;
+    size_t snapshotSize = offset + 7 <= (size_t)(result - start) ? getLittleEndian(in + 5, 2) : 0;
+    struct Game* game = NULL;
+    if (offset >= 10 && offset + 7 + snapshotSize <= (size_t)(result - start) && in[0] == LOG_CHECKPOINT) {
+        game = loadGame(in + 7, snapshotSize, false);
+    }
+    if (game == NULL || (winnerSeat != 0xFF && winnerSeat >= game->numPlayers)) {
+        fprintf(stderr, "Game %ld: checkpoint is damaged.\n", gameNumber);
+        if (game != NULL) {
+            freeGame(game);
+        }
+        return 1;
+    }
+    in += 7 + snapshotSize;
+
+    // Apply the logged actions until the requested turn starts
+    while (in < result && (toEnd || game->turns < turn || game->drawnCard >= 0)) {
+        unsigned char tag = *in++;
+        struct Move move = { MOVE_PASS, 0, SPECIAL };
+        if (tag & LOG_PLAY) {
+            move = (struct Move){ MOVE_PLAY, tag & LOG_NO_CARD, cardColor(tag & LOG_NO_CARD) };
+            if (move.color == SPECIAL && in < result && (*in & ~3) == LOG_COLOR) {
+                move.color = *in++ & 3;
+            }
+        } else if (tag & LOG_DRAW) {
+            // The draw comes from the checkpointed generator, check it matches the logged card
+            int card = tag & LOG_NO_CARD;
+            struct Hand* hand = &game->currentPlayer->hand;
+            int before = card == LOG_NO_CARD ? hand->size : hand->counts[card];
+            move.kind = MOVE_DRAW;
+            applyMove(game, &move);
+            // House rules may draw several cards, the last one is logged
+            if ((card == LOG_NO_CARD ? hand->size < before : hand->counts[card] <= before)) {
+                fprintf(stderr, "Game %ld: the log does not match the replay at turn %d.\n", gameNumber, game->turns);
+                freeGame(game);
+                return 1;
+            }
+            continue;
+        } else if (tag == LOG_CHECKPOINT) {
+            if (in + 6 > result) {
+                break;
+            }
+            in += 6 + getLittleEndian(in + 4, 2);
+            continue;
+        } else if (tag != LOG_PASS) {
+            break;
+        }
+        // Plays and passes are checked against the rules before they are applied, a Wild needs its color
+        if ((move.kind == MOVE_PLAY && move.color == SPECIAL) || !isLegalMove(game, &move)) {
+            fprintf(stderr, "Game %ld: the log does not match the replay at turn %d.\n", gameNumber, game->turns);
+            freeGame(game);
+            return 1;
+        }
+        applyMove(game, &move);
+    }
+
+    renderf("Game %ld (seed %llu), %ld turns, ", gameNumber, seed, totalTurns);
+    if (winnerSeat == 0xFF) {
+        renderf("no winner\n");
+    } else {
+        renderf("won by %s\n", game->seats[winnerSeat].name);
+    }
+    struct Card topCard = getTopCard(game);
+    renderf("Turn %d, %d cards in the deck. Top card on the pile: ", game->turns, game->deck->count);
+    printCard(&topCard);
+    renderf("\n");
+    for (int seat = 0; seat < game->numPlayers; seat++) {
+        displayHand(&game->seats[seat]);
+    }
+    if (game->winner == NULL) {
+        renderf("\nNext to play: %s\n", game->currentPlayer->name);
+    }
+    renderFlush();
+    freeGame(game);
+    return 0;
+}
+
+// Function to list the games of a replay log, or show one of them at a given turn
+int replayLog(const char* path, long gameNumber, long turn) {
+    struct LogFile log;
+    if (!openLogFile(path, &log)) {
+        fprintf(stderr, "%s is not a complete replay log.\n", path);
+        return 1;
+    }
+    int status = 0;
+    if (gameNumber < 0) {
+        // Stream through every game and print its result
+        for (long i = 0; i < log.numGames; i++) {
+            size_t end = i + 1 < log.numGames ? log.gameStarts[i + 1] : log.size;
+            const unsigned char* start = log.data + log.gameStarts[i];
+            int numCheckpoints;
+            const unsigned char* result = findLoggedResult(start, end - log.gameStarts[i], &numCheckpoints);
+            if (result == NULL) {
+                fprintf(stderr, "Game %ld: checkpoint is damaged.\n", i);
+                status = 1;
+                continue;
+            }
+            printf("Game %ld: seed %llu, %d players, %ld turns, winner seat %d\n", i,
+                   getLittleEndian(start + 1, 8), start[9], (long)getLittleEndian(result + 2, 4),
+                   result[1] == 0xFF ? -1 : result[1]);
+        }
+    } else if (gameNumber >= log.numGames) {
+        fprintf(stderr, "%s holds only %ld games.\n", path, log.numGames);
+        status = 1;
+    } else {
+        size_t end = gameNumber + 1 < log.numGames ? log.gameStarts[gameNumber + 1] : log.size;
+        status = replayLoggedGame(log.data + log.gameStarts[gameNumber], end - log.gameStarts[gameNumber],
+                                  gameNumber, turn);
+    }
+    closeLogFile(&log);
+    return status;
+}
+
+// Event bus: the game loop of each table publishes typed events into one ring per consumer and
+// goes on at once, whether or not the consumer keeps up. Each consumer thread drains its ring at
+// every table, so the rings of many tables make one queue with many producers for it.
+
+// Names of the events, in the order of enum GameEventKind
+static const char* eventNames[EVENT_NUM_KINDS] = {
+    "card_played", "card_drawn", "color_chosen", "direction_changed", "game_won"
+};
+
+// Function to write an event as one line of JSON
+static void logEvent(struct EventConsumer* consumer, int table, const struct GameEvent* event) {
+    fprintf(consumer->file, "{\"table\": %d, \"game\": %u, \"turn\": %d, \"seat\": %d, \"event\": \"%s\"",
+            table, event->game, event->turn, event->seat, eventNames[event->kind]);
+    if (event->card != NO_CARD) {
+        fprintf(consumer->file, ", \"card\": %d", event->card);
+    }
+    if (event->kind == EVENT_COLOR_CHOSEN) {
+        fprintf(consumer->file, ", \"color\": \"%s\"", getColorName(event->color));
+    }
+    if (event->kind == EVENT_DIRECTION_CHANGED) {
+        fprintf(consumer->file, ", \"direction\": %d", event->direction);
+    }
+    fprintf(consumer->file, "}\n");
+}
+
+// Function to count an event
+static void countEvent(struct EventConsumer* consumer, int table, const struct GameEvent* event) {
+    (void)table;
+    consumer->counts[event->kind]++;
+}
+
+// Function run by each consumer: take the events of every table as they come, sleeping a little
+// when there are none, until told to stop. The rings are drained once more after that.
+static void* eventConsumerThread(void* arg) {
+    struct EventConsumer* consumer = (struct EventConsumer*)arg;
+    struct GameEvent event;
+    while (1) {
+        bool stopping = atomic_load(&consumer->stop);
+        bool idle = true;
+        for (int table = 0; table < consumer->numTables; table++) {
+            while (ringPoll(&consumer->rings[table], &event)) {
+                consumer->handle(consumer, table, &event);
+                consumer->handled++;
+                idle = false;
+            }
+        }
+        if (idle) {
+            if (stopping) {
+                break;
+            }
+            nanosleep(&(struct timespec){ 0, EVENT_IDLE_NS }, NULL);
+        }
+    }
+    return NULL;
+}
+
+// Function to start the event logger, writing to a file, and the statistics collector, for a number
+// of tables. Returns NULL when the file cannot be opened.
+struct EventListeners* startEventListeners(const char* path, int numTables) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        return NULL;
+    }
+    struct EventListeners* listeners = (struct EventListeners*)calloc(1, sizeof(struct EventListeners));
+    listeners->numConsumers = 2;
+    listeners->numTables = numTables;
+    listeners->buses = (struct EventBus*)calloc(numTables, sizeof(struct EventBus));
+    listeners->consumers[0].name = "logger";
+    listeners->consumers[0].handle = logEvent;
+    listeners->consumers[0].file = file;
+    listeners->consumers[1].name = "statistics";
+    listeners->consumers[1].handle = countEvent;
+    for (int c = 0; c < listeners->numConsumers; c++) {
+        struct EventConsumer* consumer = &listeners->consumers[c];
+        consumer->rings = (struct EventRing*)aligned_alloc(64, numTables * sizeof(struct EventRing));
+        memset(consumer->rings, 0, numTables * sizeof(struct EventRing));
+        consumer->numTables = numTables;
+        atomic_init(&consumer->stop, false);
+        for (int table = 0; table < numTables; table++) {
+            listeners->buses[table].rings[c] = &consumer->rings[table];
+            listeners->buses[table].numRings = listeners->numConsumers;
+        }
+        pthread_create(&consumer->thread, NULL, eventConsumerThread, consumer);
+    }
+    return listeners;
+}
+
+// Function to stop the consumers once no table publishes anymore, and print what they saw and
+// how many events each one dropped by falling behind
+void stopEventListeners(struct EventListeners* listeners) {
+    for (int c = 0; c < listeners->numConsumers; c++) {
+        atomic_store(&listeners->consumers[c].stop, true);
+    }
+    printf("Events:");
+    for (int c = 0; c < listeners->numConsumers; c++) {
+        struct EventConsumer* consumer = &listeners->consumers[c];
+        pthread_join(consumer->thread, NULL);
+        unsigned long dropped = 0;
+        for (int table = 0; table < consumer->numTables; table++) {
+            dropped += atomic_load(&consumer->rings[table].dropped);
+        }
+        printf("%s %s %ld (dropped %lu)", c == 0 ? "" : ",", consumer->name, consumer->handled, dropped);
+        free(consumer->rings);
+    }
+    printf("\n");
+    struct EventConsumer* statistics = &listeners->consumers[1];
+    printf("Events seen by kind:");
+    for (int kind = 0; kind < EVENT_NUM_KINDS; kind++) {
+        printf(" %s %ld", eventNames[kind], statistics->counts[kind]);
+    }
+    printf("\n");
+    fclose(listeners->consumers[0].file);
+    free(listeners->buses);
+    free(listeners);
+}
+
+// SkipTurn function
+void SkipTurn(struct Game* game) {
+    TELEMETRY_COUNT(TELEMETRY_SKIPS, 1);
+    if (game->verbose) {
+        renderf("Skipping the next player's turn.\n");
+    }
+    game->currentPlayer = playerAfter(game, game->currentPlayer, 1); // Move to the next player
+}
+
+// Define the kinds of words the command parser knows
+enum Keyword {
+    KEYWORD_COLOR,  // A color, or "special" for Wilds
+    KEYWORD_TYPE,   // A card type
+    KEYWORD_DRAW,   // Draw a card, or the Draw Two type after a color
+    KEYWORD_SAVE,
+    KEYWORD_HINT,
+    KEYWORD_EXIT,
+    KEYWORD_YES,
+    KEYWORD_NO
+};
+
+// Define a known word and the color or type it names
+struct KeywordEntry {
+    const char* word;
+    enum Keyword keyword;
+    int value;      // Color for KEYWORD_COLOR, type for KEYWORD_TYPE and KEYWORD_DRAW
+};
+
+static const struct KeywordEntry keywordList[] = {
+    { "red", KEYWORD_COLOR, RED }, { "blue", KEYWORD_COLOR, BLUE }, { "green", KEYWORD_COLOR, GREEN },
+    { "yellow", KEYWORD_COLOR, YELLOW }, { "special", KEYWORD_COLOR, SPECIAL },
+    { "0", KEYWORD_TYPE, ZERO }, { "1", KEYWORD_TYPE, ONE }, { "2", KEYWORD_TYPE, TWO },
+    { "3", KEYWORD_TYPE, THREE }, { "4", KEYWORD_TYPE, FOUR }, { "5", KEYWORD_TYPE, FIVE },
+    { "6", KEYWORD_TYPE, SIX }, { "7", KEYWORD_TYPE, SEVEN }, { "8", KEYWORD_TYPE, EIGHT },
+    { "9", KEYWORD_TYPE, NINE }, { "skip", KEYWORD_TYPE, SKIP }, { "reverse", KEYWORD_TYPE, REVERSE },
+    { "draw", KEYWORD_DRAW, DRAW_TWO }, { "wild", KEYWORD_TYPE, WILD }, { "wilddraw", KEYWORD_TYPE, WILD_DRAW },
+    { "save", KEYWORD_SAVE, 0 }, { "hint", KEYWORD_HINT, 0 }, { "exit", KEYWORD_EXIT, 0 },
+    { "y", KEYWORD_YES, 0 }, { "yes", KEYWORD_YES, 0 }, { "n", KEYWORD_NO, 0 }, { "no", KEYWORD_NO, 0 }
+};
+
+// Define a token of input: the text as typed and the known word it matches
+struct Token {
+    char text[MAX_TOKEN_LENGTH + 1];
+    const struct KeywordEntry* entry; // NULL when the token is no known word
+};
+
+// Define where commands are read from: the terminal, or a whole recorded session in a file or pipe
+struct InputReader {
+    int fd;
+    int length;     // Bytes in the buffer
+    int position;   // Next byte to read
+    char buffer[INPUT_BUFFER_SIZE];
+};
+
+static struct InputReader input;
+// Keyword hash table, indexed by the hash of the lowercase word: index + 1 into keywordList, 0 when empty
+static unsigned char keywordTable[KEYWORD_TABLE_SIZE];
+static pthread_once_t keywordTableOnce = PTHREAD_ONCE_INIT;
+
+// Function to hash one more lowercase byte of a word
+static inline unsigned int hashByte(unsigned int hash, unsigned char c) {
+    return (hash * 33) ^ c;
+}
+
+// Function to fill the keyword hash table, with linear probing on collisions
+static void initKeywordTable() {
+    for (int i = 0; i < (int)(sizeof(keywordList) / sizeof(keywordList[0])); i++) {
+        unsigned int hash = 5381;
+        for (const char* c = keywordList[i].word; *c; c++) {
+            hash = hashByte(hash, *c);
+        }
+        unsigned int slot = hash & (KEYWORD_TABLE_SIZE - 1);
+        while (keywordTable[slot] != 0) {
+            slot = (slot + 1) & (KEYWORD_TABLE_SIZE - 1);
+        }
+        keywordTable[slot] = i + 1;
+    }
+}
+
+// Function to read commands from a file instead of the terminal, "-" for standard input
+bool openScriptInput(const char* path) {
+    int fd = strcmp(path, "-") == 0 ? 0 : open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    input.fd = fd;
+    return true;
+}
+
+// Function to get the next byte of input, EOF at the end. The buffer is refilled a block at a time.
+static inline int inputByte() {
+    if (input.position == input.length) {
+        // Prompts must be visible before waiting for the answer
+        fflush(stdout);
+        ssize_t length;
+        do {
+            length = read(input.fd, input.buffer, sizeof(input.buffer));
+        } while (length < 0 && errno == EINTR);
+        if (length <= 0) {
+            return EOF;
+        }
+        input.length = (int)length;
+        input.position = 0;
+    }
+    return (unsigned char)input.buffer[input.position++];
+}
+
+// Function to read the next token separated by white space, in one pass over the input: each byte is
+// copied, lowercased and hashed, then the word is looked up. Returns false at the end of the input.
+static bool readToken(struct Token* token) {
+    pthread_once(&keywordTableOnce, initKeywordTable);
+    int c;
+    do {
+        c = inputByte();
+    } while (c != EOF && isspace(c));
+    if (c == EOF) {
+        return false;
+    }
+
+    char lower[MAX_TOKEN_LENGTH + 1];
+    unsigned int hash = 5381;
+    int length = 0;
+    for (; c != EOF && !isspace(c); c = inputByte()) {
+        if (length < MAX_TOKEN_LENGTH) {
+            token->text[length] = (char)c;
+            lower[length] = (char)tolower(c);
+            hash = hashByte(hash, lower[length]);
+            length++;
+        }
+    }
+    token->text[length] = '\0';
+    lower[length] = '\0';
+
+    token->entry = NULL;
+    for (unsigned int slot = hash & (KEYWORD_TABLE_SIZE - 1); keywordTable[slot] != 0;
+         slot = (slot + 1) & (KEYWORD_TABLE_SIZE - 1)) {
+        const struct KeywordEntry* entry = &keywordList[keywordTable[slot] - 1];
+        if (strcmp(entry->word, lower) == 0) {
+            token->entry = entry;
+            break;
+        }
+    }
+    return true;
+}
+
+// Function to read the next word separated by white space whatever its length, such as a player's name.
+// Returns the word in a buffer the caller frees, NULL at the end of the input.
+static char* readWord() {
+    int c;
+    do {
+        c = inputByte();
+    } while (c != EOF && isspace(c));
+    if (c == EOF) {
+        return NULL;
+    }
+    size_t capacity = MAX_TOKEN_LENGTH + 1;
+    size_t length = 0;
+    char* word = (char*)malloc(capacity);
+    for (; c != EOF && !isspace(c); c = inputByte()) {
+        if (length + 1 == capacity) {
+            capacity *= 2;
+            word = (char*)realloc(word, capacity);
+        }
+        word[length++] = (char)c;
+    }
+    word[length] = '\0';
+    return word;
+}
+
+// Function to check whether a token is the given keyword
+static bool isKeyword(const struct Token* token, enum Keyword keyword) {
+    return token->entry != NULL && token->entry->keyword == keyword;
+}
+
+// Function to read a token as a number, returns false when it is not one
+static bool tokenNumber(const struct Token* token, int* number) {
+    char* end;
+    long value = strtol(token->text, &end, 10);
+    if (end == token->text || *end != '\0' || value < INT_MIN || value > INT_MAX) {
+        return false;
+    }
+    *number = (int)value;
+    return true;
+}
+
+// Function to read a menu choice, 0 when it is not a number. Returns false at the end of the input.
+bool readChoice(int* choice) {
+    struct Token token;
+    if (!readToken(&token)) {
+        return false;
+    }
+    if (!tokenNumber(&token, choice)) {
+        *choice = 0;
+    }
+    return true;
+}
+
+// Wild card Function, returns the color chosen for the next play, SPECIAL at the end of the input
+enum Color Wild() {
+    renderf("Choose the color for the next play:\n");
+    renderf("1. RED\n2. BLUE\n3. GREEN\n4. YELLOW\n");
+    renderFlush();
+    struct Token token;
+    if (!readToken(&token)) {
+        return SPECIAL;
+    }
+    renderNewFrame();
+    // The color may also be given by name
+    if (isKeyword(&token, KEYWORD_COLOR) && token.entry->value != SPECIAL) {
+        return (enum Color)token.entry->value;
+    }
+    int choice = 0;
+    tokenNumber(&token, &choice);
+
+    // Return the color based on the player's choice
+    switch(choice) {
+        case 1:
+            return RED;
+        case 2:
+            return BLUE;
+        case 3:
+            return GREEN;
+        case 4:
+            return YELLOW;
+        default:
+            renderf("Invalid choice. ReEnter Your Choice .\n");
+            return Wild();
+    }
+}
+
+// Draw Two Function
+void Draw_Two(struct Game* game, struct Player* nextplayer) {
+    TELEMETRY_COUNT(TELEMETRY_DRAW_TWOS, 1);
+    if (game->verbose) {
+        renderf("\nPlayer %s Drew The Following Cards:\n", nextplayer->name);
+    }
+    for (int i = 0; i < 2; i++) {
+        int card = drawCard(game, nextplayer);
+        if (card >= 0 && game->verbose) {
+            displayLastCard(card);
+        }
+    }
+}
+
+// WILD DRAW FOUR function
+void WildDraw(struct Game* game, struct Player* nextplayer) {
+    TELEMETRY_COUNT(TELEMETRY_WILD_DRAWS, 1);
+    if (game->verbose) {
+        renderf("\nPlayer %s Drew The Following Cards:\n", nextplayer->name);
+    }
+    for (int i = 0; i < 4; i++) {
+        int card = drawCard(game, nextplayer);
+        if (card >= 0 && game->verbose) {
+            displayLastCard(card);
+        }
+    }
+}
+
+// function to handle reverse: the seats stay in place and play goes the other way around them
+void reverseDirection(struct Game* game) {
+    game->direction = -game->direction;
+    if (game->events != NULL) {
+        publishEvent(game, EVENT_DIRECTION_CHANGED, game->currentPlayer->seat, NO_CARD, SPECIAL);
+    }
+}
+
+// Function to leave the program in the middle of a game, closing the replay log of the session
+// even when this game is not logged
+static void exitGame(struct Game* game) {
+    renderf("Exiting the game...\n");
+    renderFlush();
+    if (game->log != NULL) {
+        endGameLog(game);
+    }
+    if (sessionLog != NULL) {
+        closeLogWriter(sessionLog);
+    }
+    if (sessionEvents != NULL) {
+        stopEventListeners(sessionEvents);
+    }
+#ifdef UNO_TELEMETRY
+    if (telemetryFormat != NULL) {
+        printThreadTelemetry(telemetryFormat);
+    }
+#endif
+    freeGame(game);
+    exit(0); // Exit the program
+}
+
+// Function to show the current player what the others may hold, in the order they play
+static void displayHint(struct Game* game) {
+    int observer = game->currentPlayer->seat;
+    for (int steps = 1; steps < game->numPlayers; steps++) {
+        const struct Player* other = playerAfter(game, game->currentPlayer, steps);
+        renderf("%s holds %d cards:", other->name, other->hand.size);
+        for (enum Color color = RED; color <= YELLOW; color++) {
+            renderf(" %s %.0f%%", getColorName(color), 100 * holdProbability(game, observer, other->seat, COLOR_MASK(color)));
+        }
+        renderf(" Wild %.0f%%\n", 100 * holdProbability(game, observer, other->seat, WILD_MASK));
+    }
+}
+
+// Function to ask the human player for a move and apply it. The end of the input exits the game.
+void playTurn(struct Game* game) {
+    struct Player* player = game->currentPlayer;
+    if (player->strategy != NULL) {
+        playBotTurn(game);
+        return;
+    }
+
+    struct Card topCard = getTopCard(game);
+    bool showTable = true;
+
+    while (1) {
+        // Print the top card on the pile, again with every prompt when the screen is redrawn
+        if (showTable || render.mode == RENDER_ANSI) {
+            renderf("Top card on the pile: ");
+            printCard(&topCard);
+            displayHand(player);
+            if (game->pendingDraw > 0) {
+                renderf("Stack a draw card or draw %d cards.\n", game->pendingDraw);
+            }
+            showTable = false;
+        }
+        // Choose a card to play or type "Draw" to draw a card
+        renderf("Choose a card to play (enter color and type) or type 'Draw' to draw a card, 'Hint', 'Save' or 'Exit': ");
+        renderFlush();
+        struct Token token;
+        if (!readToken(&token)) {
+            exitGame(game);
+        }
+        renderNewFrame();
+        // Check if the player wants to exit the game
+        if (isKeyword(&token, KEYWORD_EXIT)) {
+            exitGame(game);
+        }
+
+        // Check if the player asks what the others may hold
+        if (isKeyword(&token, KEYWORD_HINT)) {
+            displayHint(game);
+            continue;
+        }
+
+        // Check if the player wants to save the game
+        if (isKeyword(&token, KEYWORD_SAVE)) {
+            if (saveGameToFile(game, SAVE_FILE)) {
+                renderf("Game saved to %s.\n", SAVE_FILE);
+            } else {
+                renderf("Could not save the game to %s.\n", SAVE_FILE);
+            }
+            continue;
+        }
+
+        // Check if the player chose to draw a card
+        if (isKeyword(&token, KEYWORD_DRAW)) {
+            struct Move move = { MOVE_DRAW, 0, SPECIAL };
+            if (!isLegalMove(game, &move)) {
+                renderf("You must play a card.\n");
+                continue;
+            }
+            applyMove(game, &move);
+            int drawnCard = game->drawnCard;
+            while (drawnCard >= 0) {
+                renderf("Do you want to play the card? [Y/N]: ");
+                renderFlush();
+                if (!readToken(&token)) {
+                    exitGame(game);
+                }
+                renderNewFrame();
+                if (isKeyword(&token, KEYWORD_YES)) {
+                    // Play the card
+                    move = (struct Move){ MOVE_PLAY, drawnCard, cardColor(drawnCard) };
+                    if (move.color == SPECIAL && (move.color = Wild()) == SPECIAL) {
+                        exitGame(game);
+                    }
+                    applyMove(game, &move);
+                    return;
+                } else if (isKeyword(&token, KEYWORD_NO)) {
+                    move = (struct Move){ MOVE_PASS, 0, SPECIAL };
+                    if (!isLegalMove(game, &move)) {
+                        renderf("You must play the card.\n");
+                        continue;
+                    }
+                    renderf("Card was not played.\n");
+                    applyMove(game, &move);
+                    return;
+                } else {
+                    renderf("Invalid choice. Please enter 'Y' or 'N'.\n");
+                }
+            }
+            return;
+        }
+
+        // Convert the input to color and type
+        if (!isKeyword(&token, KEYWORD_COLOR)) {
+            renderf("Invalid input. Try again.\n");
+            continue; // Prompt the player to enter their choice again
+        }
+        enum Color color = (enum Color)token.entry->value;
+
+        // Read the type
+        if (!readToken(&token)) {
+            exitGame(game);
+        }
+        if (!isKeyword(&token, KEYWORD_TYPE) && !isKeyword(&token, KEYWORD_DRAW)) {
+            renderf("Invalid input. Try again.\n");
+            continue; // Prompt the player to enter their choice again
+        }
+        enum Type type = (enum Type)token.entry->value;
+
+        // Check the chosen card is in the player's hand
+        if ((color == SPECIAL) != (type == WILD || type == WILD_DRAW)
+            || player->hand.counts[makeCard(color, type)] == 0) {
+            renderf("You do not have that card in your hand!\n");
+            continue;
+        }
+        // Check if the chosen card is playable under the rules of the table
+        struct Move move = { MOVE_PLAY, makeCard(color, type), color };
+        if (!isLegalMove(game, &move)) {
+            renderf("Invalid move. Try again.\n");
+            continue; // Prompt the player to enter the card details again
+        }
+
+        if (color == SPECIAL && (move.color = Wild()) == SPECIAL) {
+            exitGame(game);
+        }
+        applyMove(game, &move);
+        return; // Player's turn completed
+    }
+}
+
+// Function to start the game
+void playGame(unsigned long long seed, unsigned int rules) {
+    printf("Starting the game... (replay it with --seed %llu)\n", seed);
+
+    struct Token token;
+    int numPlayers;
+
+        do {
+        printf("Enter number of players (between 2 and %d): ", MAX_DECKS * PLAYERS_PER_DECK);
+        if (!readToken(&token)) {
+            return;
+        }
+        if (!tokenNumber(&token, &numPlayers)) {
+            printf("Invalid input. Please enter a valid number.\n");
+            numPlayers = 0;
+            continue; // Continue to next iteration
+        }
+
+        if (numPlayers < 2 || numPlayers > MAX_DECKS * PLAYERS_PER_DECK) {
+            printf("Invalid number of players. Please enter a number between 2 and %d.\n", MAX_DECKS * PLAYERS_PER_DECK);
+        }
+    } while (numPlayers < 2 || numPlayers > MAX_DECKS * PLAYERS_PER_DECK);
+
+    // The game keeps copies of the names, which are read whole and only held until it starts
+    char** names = (char**)calloc(numPlayers, sizeof(char*));
+    enum StrategyKind* kinds = (enum StrategyKind*)malloc(numPlayers * sizeof(enum StrategyKind));
+    struct Strategy* strategies = (struct Strategy*)malloc(numPlayers * sizeof(struct Strategy));
+    bool ready = true;
+    for (int i = 0; ready && i < numPlayers; i++) {
+        printf("Enter player %d's name: ", i + 1);
+        if ((names[i] = readWord()) == NULL) {
+            ready = false;
+            break;
+        }
+        do {
+            printf("Who plays %s? (human, random, greedy or search): ", names[i]);
+            if (!readToken(&token)) {
+                ready = false;
+                break;
+            }
+        } while (!parseStrategyKind(token.text, &kinds[i]));
+    }
+
+    if (ready) {
+        struct Game* game = createGame((const char**)names, numPlayers, true, seed);
+        game->rules = rules;
+        // Bots get their own random numbers, so the deal of the game does not depend on them
+        for (int i = 0; i < numPlayers; i++) {
+            if (kinds[i] != STRATEGY_HUMAN) {
+                initStrategy(&strategies[i], kinds[i], gameSeed(seed, i + 1), &searchBudget);
+                game->seats[i].strategy = &strategies[i];
+            }
+        }
+
+        printf("\nGame Started\n");
+        runGame(game, seed);
+    }
+    for (int i = 0; i < numPlayers; i++) {
+        free(names[i]);
+    }
+    free(names);
+    free(kinds);
+    free(strategies);
+}
+
+// Function to continue the game saved in SAVE_FILE
+void resumeGame() {
+    struct Game* game = loadGameFromFile(SAVE_FILE, true);
+    if (game == NULL) {
+        printf("No saved game could be loaded from %s.\n", SAVE_FILE);
+        return;
+    }
+    printf("\nGame Resumed\n");
+    // The seed of a resumed game is not known, it is logged as 0
+    runGame(game, 0);
+}
+
+// Function to play turns until someone wins, then release the game
+void runGame(struct Game* game, unsigned long long seed) {
+    struct GameLog log;
+    // Checkpoints are snapshots, which hold tables of up to MAX_PLAYERS players
+    bool logged = sessionLog != NULL && game->numPlayers <= MAX_PLAYERS;
+    if (logged) {
+        initGameLog(&log, sessionLog);
+        beginGameLog(&log, game, seed);
+    } else if (sessionLog != NULL) {
+        printf("Games of more than %d players are not logged.\n", MAX_PLAYERS);
+    }
+    if (sessionEvents != NULL) {
+        game->events = &sessionEvents->buses[0];
+    }
+    renderReset();
+    while (getWinner(game) == NULL) {
+        TELEMETRY_START(turnStart);
+        playTurn(game);
+        renderFlush();
+        TELEMETRY_STOP(TELEMETRY_TURN_NS, turnStart);
+    }
+    TELEMETRY_COUNT(TELEMETRY_GAMES, 1);
+    TELEMETRY_COUNT(TELEMETRY_TURNS, game->turns);
+    TELEMETRY_RECORD(TELEMETRY_TURNS_PER_GAME, game->turns);
+    renderf("Player %s wins the game!\n", getWinner(game)->name);
+    renderFlush();
+    renderReset();
+    if (logged) {
+        endGameLog(game);
+        freeGameLog(&log);
+    }
+    if (game->events != NULL) {
+        game->events->game++;
+    }
+    // Free dynamically allocated memory
+    freeGame(game);
+}
+
+// Function to get a wall clock time in seconds
+static double getTime() {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Scripted player used by the simulation: plays the first legal card, plays a drawn card
+// whenever it can, and picks the color it holds the most cards of for a Wild
+struct Move chooseScriptedMove(struct Game* game, struct Move* moves, int numMoves) {
+    struct Move move = moves[0];
+    (void)numMoves;
+    if (move.kind == MOVE_PLAY && cardColor(move.card) == SPECIAL) {
+        const unsigned char* held = game->currentPlayer->hand.counts;
+        int counts[SPECIAL] = { 0 };
+        for (unsigned char card = 0; card < CARD(SPECIAL, 0); card++) {
+            counts[card / 13] += held[card];
+        }
+        for (enum Color color = RED; color <= YELLOW; color++) {
+            if (counts[color] > counts[move.color]) {
+                move.color = color;
+            }
+        }
+    }
+    return move;
+}
+
+// Names of the player kinds, in the order of enum StrategyKind
+static const char* strategyNames[] = { "human", "scripted", "random", "greedy", "search" };
+
+// Function to read a player kind from its name, in any case
+bool parseStrategyKind(const char* text, enum StrategyKind* kind) {
+    for (enum StrategyKind k = STRATEGY_HUMAN; k <= STRATEGY_SEARCH; k++) {
+        if (strcasecmp(text, strategyNames[k]) == 0) {
+            *kind = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to count the colored cards the current player holds of each color
+static void countColors(const struct Game* game, int counts[SPECIAL]) {
+    const unsigned char* held = game->currentPlayer->hand.counts;
+    for (enum Color color = RED; color <= YELLOW; color++) {
+        counts[color] = 0;
+    }
+    for (unsigned long long mask = game->currentPlayer->hand.mask & ~WILD_MASK; mask != 0; mask &= mask - 1) {
+        unsigned char card = __builtin_ctzll(mask);
+        counts[card / 13] += held[card];
+    }
+}
+
+// Scripted strategy
+static struct Move scriptedStrategy(struct Strategy* strategy, struct Game* game, struct Move* moves, int numMoves) {
+    (void)strategy;
+    return chooseScriptedMove(game, moves, numMoves);
+}
+
+// Random strategy: any legal move, each as likely
+static struct Move randomStrategy(struct Strategy* strategy, struct Game* game, struct Move* moves, int numMoves) {
+    (void)game;
+    return moves[rngBounded(&strategy->rng, numMoves)];
+}
+
+// Greedy strategy: always play when possible, stay in the colors held the most, keep the Wilds for later
+// and use the action cards on a next player who is about to win
+static struct Move greedyStrategy(struct Strategy* strategy, struct Game* game, struct Move* moves, int numMoves) {
+    (void)strategy;
+    int counts[SPECIAL];
+    countColors(game, counts);
+    bool threat = playerAfter(game, game->currentPlayer, 1)->hand.size <= 2;
+    int best = 0;
+    int bestScore = -1;
+    for (int i = 0; i < numMoves; i++) {
+        int score = 0;
+        if (moves[i].kind == MOVE_PLAY) {
+            enum Type type = cardType(moves[i].card);
+            score = (type >= WILD ? 5 : 10) + counts[moves[i].color];
+            if (type >= SKIP) {
+                score += threat ? 20 : 2;
+            }
+        }
+        if (score > bestScore) {
+            best = i;
+            bestScore = score;
+        }
+    }
+    return moves[best];
+}
+
+// Define a node of a search tree. The tree is shared by every deal of the hidden cards,
+// so a node stands for a sequence of moves, not for a state.
+struct SearchNode {
+    struct Move move;            // Move that leads to this node from its parent
+    int mover;                   // Seat of the player who made that move
+    int firstChild;              // Index of the first child, -1 for none
+    int nextSibling;             // Index of the next child of the same parent, -1 for none
+    unsigned int visits;         // Playouts through this node
+    unsigned int available;      // Playouts in which the move was legal when the parent was reached
+    double wins;                 // Playouts through this node won by the mover
+};
+
+// Define the work of one search thread, growing its own tree from the same root (root parallelism)
+struct SearchWorker {
+    pthread_t thread;
+    const struct Game* root;     // Position to search, only read
+    struct Rng rng;
+    long playouts;               // Playouts to run, 0 for no limit
+    double deadline;             // Time to stop at, 0 for no limit
+    struct SearchNode* nodes;
+    int numNodes;
+    int capacity;
+    long done;                   // Playouts run
+};
+
+// Function to check if two moves are the same
+static bool sameMove(const struct Move* a, const struct Move* b) {
+    return a->kind == b->kind && a->card == b->card && a->color == b->color;
+}
+
+// Function to add a node to a search tree, returns its index
+static int addSearchNode(struct SearchWorker* worker, int parent, const struct Move* move, int mover) {
+    if (worker->numNodes == worker->capacity) {
+        worker->capacity *= 2;
+        worker->nodes = (struct SearchNode*)realloc(worker->nodes, worker->capacity * sizeof(struct SearchNode));
+    }
+    int index = worker->numNodes++;
+    struct SearchNode* node = &worker->nodes[index];
+    node->move = *move;
+    node->mover = mover;
+    node->firstChild = -1;
+    node->visits = 0;
+    node->available = 0;
+    node->wins = 0;
+    if (parent >= 0) {
+        node->nextSibling = worker->nodes[parent].firstChild;
+        worker->nodes[parent].firstChild = index;
+    } else {
+        node->nextSibling = -1;
+    }
+    return index;
+}
+
+// Function to run one playout: deal the hidden cards, walk down the tree choosing moves with UCB
+// among the ones legal in this deal, add one node, finish the game at random and count the result
+static void searchPlayout(struct SearchWorker* worker, struct Game* game, struct Move* moves, int* path) {
+    copyGame(game, worker->root);
+    determinize(game, worker->root->currentPlayer->seat, &worker->rng);
+
+    int node = 0;
+    int depth = 0;
+    bool expanded = false;
+    while (getWinner(game) == NULL && !expanded) {
+        int numMoves = listLegalMoves(game, moves);
+        struct SearchNode* nodes = worker->nodes;
+        double logAvailable = 0;
+        int best = -1;
+        double bestScore = -1;
+        int numUntried = 0;
+        // Children whose move is legal in this deal become available; the others are left out
+        for (int i = 0; i < numMoves; i++) {
+            int child = nodes[node].firstChild;
+            while (child >= 0 && !sameMove(&nodes[child].move, &moves[i])) {
+                child = nodes[child].nextSibling;
+            }
+            if (child < 0) {
+                moves[numUntried++] = moves[i];
+                continue;
+            }
+            nodes[child].available++;
+            if (numUntried == 0) {
+                logAvailable = log(nodes[child].available);
+                double score = nodes[child].wins / nodes[child].visits
+                             + SEARCH_EXPLORATION * sqrt(logAvailable / nodes[child].visits);
+                if (score > bestScore) {
+                    best = child;
+                    bestScore = score;
+                }
+            }
+        }
+        int mover = game->currentPlayer->seat;
+        if (numUntried > 0) {
+            struct Move move = moves[rngBounded(&worker->rng, numUntried)];
+            node = addSearchNode(worker, node, &move, mover);
+            applyMove(game, &move);
+            expanded = true;
+        } else {
+            node = best;
+            applyMove(game, &worker->nodes[node].move);
+        }
+        path[depth++] = node;
+    }
+
+    // Finish the game with random plays, drawing only when nothing can be played.
+    // A draw or pass comes last in the list of legal moves, when there is one at all: RULE_FORCED_PLAY
+    // lists none once a card can be played.
+    int limit = game->turns + SEARCH_PLAYOUT_TURNS;
+    while (getWinner(game) == NULL && game->turns < limit) {
+        int numMoves = listLegalMoves(game, moves);
+        int numPlays = numMoves > 1 && moves[numMoves - 1].kind != MOVE_PLAY ? numMoves - 1 : numMoves;
+        applyMove(game, &moves[rngBounded(&worker->rng, numPlays)]);
+    }
+
+    int winner = getWinner(game) == NULL ? -1 : getWinner(game)->seat;
+    for (int i = 0; i < depth; i++) {
+        struct SearchNode* step = &worker->nodes[path[i]];
+        step->visits++;
+        step->wins += winner == step->mover ? 1.0 : (winner < 0 ? 1.0 / game->numPlayers : 0.0);
+    }
+    worker->nodes[0].visits++;
+}
+
+// Function run by each search thread: playouts until the budget is spent
+static void* searchWorker(void* arg) {
+    struct SearchWorker* worker = (struct SearchWorker*)arg;
+    struct Move* moves = (struct Move*)malloc(MAX_MOVES * sizeof(struct Move));
+    int* path = (int*)malloc((SEARCH_PLAYOUT_TURNS + MAX_TURNS) * sizeof(int));
+    struct Game* game = cloneGame(worker->root);
+    worker->capacity = 1024;
+    worker->nodes = (struct SearchNode*)malloc(worker->capacity * sizeof(struct SearchNode));
+    worker->numNodes = 0;
+    addSearchNode(worker, -1, &(struct Move){ MOVE_PASS, 0, SPECIAL }, -1);
+
+    worker->done = 0;
+    while (worker->playouts == 0 || worker->done < worker->playouts) {
+        if (worker->deadline > 0 && worker->done % SEARCH_CLOCK_INTERVAL == 0 && getTime() >= worker->deadline) {
+            break;
+        }
+        searchPlayout(worker, game, moves, path);
+        worker->done++;
+    }
+    freeGame(game);
+    free(path);
+    free(moves);
+    return NULL;
+}
+
+// Search strategy: information-set Monte Carlo tree search. Every playout deals the hidden cards anew,
+// so the tree only trusts what the player can see. Each thread grows its own tree; the move whose
+// root children were visited the most over all trees is played.
+static struct Move searchStrategy(struct Strategy* strategy, struct Game* game, struct Move* moves, int numMoves) {
+    if (numMoves == 1) {
+        return moves[0];
+    }
+    int numThreads = strategy->budget.threads;
+    struct SearchWorker* workers = (struct SearchWorker*)calloc(numThreads, sizeof(struct SearchWorker));
+    double start = getTime();
+    for (int i = 0; i < numThreads; i++) {
+        workers[i].root = game;
+        rngSplit(&strategy->rng, &workers[i].rng);
+        workers[i].playouts = strategy->budget.playouts > 0
+                            ? (strategy->budget.playouts + numThreads - 1) / numThreads : 0;
+        workers[i].deadline = strategy->budget.seconds > 0 ? start + strategy->budget.seconds : 0;
+    }
+    if (numThreads == 1) {
+        searchWorker(&workers[0]);
+    } else {
+        for (int i = 0; i < numThreads; i++) {
+            pthread_create(&workers[i].thread, NULL, searchWorker, &workers[i]);
+        }
+        for (int i = 0; i < numThreads; i++) {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
+
+    // Add up the visits of each root move over all trees
+    int best = 0;
+    unsigned long bestVisits = 0;
+    for (int m = 0; m < numMoves; m++) {
+        unsigned long visits = 0;
+        for (int i = 0; i < numThreads; i++) {
+            for (int child = workers[i].nodes[0].firstChild; child >= 0; child = workers[i].nodes[child].nextSibling) {
+                if (sameMove(&workers[i].nodes[child].move, &moves[m])) {
+                    visits += workers[i].nodes[child].visits;
+                }
+            }
+        }
+        if (visits > bestVisits) {
+            best = m;
+            bestVisits = visits;
+        }
+    }
+    for (int i = 0; i < numThreads; i++) {
+        strategy->playouts += workers[i].done;
+        free(workers[i].nodes);
+    }
+    strategy->searchTime += getTime() - start;
+    free(workers);
+    return moves[best];
+}
+
+// Function to set up a player strategy
+void initStrategy(struct Strategy* strategy, enum StrategyKind kind, unsigned long long seed,
+                  const struct SearchBudget* budget) {
+    static struct Move (*const chooseMoves[])(struct Strategy*, struct Game*, struct Move*, int) = {
+        NULL, scriptedStrategy, randomStrategy, greedyStrategy, searchStrategy
+    };
+    strategy->kind = kind;
+    strategy->chooseMove = chooseMoves[kind];
+    rngSeed(&strategy->rng, seed);
+    strategy->budget = *budget;
+    strategy->playouts = 0;
+    strategy->searchTime = 0;
+}
+
+// Function to let the bot of the current player play its whole turn, including a drawn card
+void playBotTurn(struct Game* game) {
+    struct Player* player = game->currentPlayer;
+    struct Strategy* strategy = player->strategy;
+    struct Move moves[MAX_MOVES];
+    if (game->verbose) {
+        renderf("Top card on the pile: ");
+        struct Card topCard = getTopCard(game);
+        printCard(&topCard);
+        renderf("\n%s (%s bot) holds %d cards.\n", player->name, strategyNames[strategy->kind], player->hand.size);
+    }
+    do {
+        long playouts = strategy->playouts;
+        double searchTime = strategy->searchTime;
+        int numMoves = listLegalMoves(game, moves);
+        struct Move move = strategy->chooseMove(strategy, game, moves, numMoves);
+        if (game->verbose && strategy->playouts > playouts) {
+            renderf("%s thought over %ld playouts (%.0f/s).\n", player->name, strategy->playouts - playouts,
+                   (strategy->playouts - playouts) / (strategy->searchTime - searchTime));
+        }
+        applyMove(game, &move);
+        if (game->verbose && move.kind == MOVE_PLAY && cardColor(move.card) == SPECIAL) {
+            renderf("%s chose %s.\n", player->name, getColorName(move.color));
+        }
+    } while (game->drawnCard >= 0 && getWinner(game) == NULL);
+}
+
+// Endgame solver: with every hand and the generator state known, the cards each draw brings are known
+// too, so a position can be solved exactly. Depth-first proof-number search (df-pn) runs twice, once
+// to prove that the player to move can force a win and once to prove that the others, all playing
+// against them, can force a loss. Positions are keyed by Zobrist hashes and kept in a transposition
+// table that all threads share without locks; helper threads break ties between moves in another
+// order, so they work on other parts of the tree (lazy SMP).
+
+// Define an entry of the transposition table. Entries are written without locks: check holds the key
+// xor the data, so an entry torn by two threads writing at once fails the check and is ignored.
+// Data holds the proof number in bits 0-23, the disproof number in bits 24-47, the plies left in
+// bits 48-55, then the horizon and recycled flags of struct SolverNode.
+struct SolverEntry {
+    atomic_ullong check;
+    atomic_ullong data;
+};
+
+// Define the Zobrist keys, one random number per feature of a position
+struct ZobristKeys {
+    unsigned long long hands[MAX_PLAYERS][NUM_CARD_IDS][MAX_COPIES + 1]; // Copies of a card held by a seat
+    unsigned long long topCard[NUM_CARD_IDS];
+    unsigned long long activeColor[SPECIAL];
+    unsigned long long seat[MAX_PLAYERS];                   // Seat to move
+    unsigned long long reversed;
+    unsigned long long drawnCard[NUM_CARD_IDS + 1];         // Card drawn this turn, plus one
+    unsigned long long pendingDraw[64];
+    unsigned long long pileCounts[2][DECK_SIZE + 1];        // Size of the deck, of the discard pile
+    unsigned long long deck[DECK_SIZE][NUM_CARD_IDS];       // Card at a place of the deck
+    unsigned long long goal;                                // Proving a loss rather than a win
+};
+
+// Define what the search knows of a position
+struct SolverNode {
+    unsigned long long key;
+    unsigned int proof;          // Estimated effort to prove the goal, 0 once proven
+    unsigned int disproof;       // Estimated effort to disprove it, 0 once disproven
+    bool horizon;                // A line below was cut by the ply limit, a disproof may not hold deeper
+    bool recycled;               // A line below recycles the discard pile, whose order is not in the key
+    bool extended;               // Reached by a move that costs no ply
+};
+
+// Define the state shared by the threads solving one position
+struct Solver {
+    int rootSeat;                // Seat of the player to move at the root
+    int maxPlies;
+    long maxNodes;               // Positions each search may visit over all threads, 0 for no limit
+    int numThreads;
+    bool loss;                   // Proving that the root player loses rather than wins
+    unsigned long long salt;     // Mixed into every key, so entries of earlier solves never match
+    atomic_bool stop;            // Set once the first thread is done or the node budget is spent
+};
+
+// Define one thread of the solver
+struct SolverWorker {
+    pthread_t thread;
+    struct Solver* solver;
+    int index;                   // 0 for the thread whose result counts, helpers after it
+    struct Game* game;           // Position searched, moves are made and taken back on it
+    struct UndoLog undoLog;      // Moves of the current line
+    struct Move* moves;          // Legal moves at each ply, MAX_MOVES per ply
+    struct SolverNode* children; // Positions after each of these moves, MAX_MOVES per ply
+    struct SolverNode root;      // What the last search found of the root
+    int numRootMoves;
+    long nodes;
+    long startNodes;             // Nodes when the current search started
+    bool aborted;                // The stop flag was seen, the search is unfinished
+};
+
+static struct ZobristKeys zobrist;
+static struct SolverEntry* solverTable;
+static atomic_ullong solverCount;
+static pthread_once_t solverOnce = PTHREAD_ONCE_INIT;
+
+// Function to fill the Zobrist keys and allocate the transposition table, once per process
+static void initSolver() {
+    unsigned long long state = 0x5A0B1575EEDULL;
+    unsigned long long* keys = (unsigned long long*)&zobrist;
+    for (size_t i = 0; i < sizeof(zobrist) / sizeof(*keys); i++) {
+        keys[i] = splitMix64(&state);
+    }
+    solverTable = (struct SolverEntry*)calloc((size_t)1 << SOLVER_TABLE_BITS, sizeof(struct SolverEntry));
+}
+
+// Function to compute the Zobrist key of a position. Besides the hands, the top card, the seat to
+// move and the direction, the key covers what decides the cards to come: the generator state and,
+// once the discard pile was recycled, the order of the deck. Before that the deck follows from the
+// generator state. The discard pile holds every other card, so only its order is left out, which
+// matters only if it gets recycled: positions searched through a recycle are marked as such.
+static unsigned long long positionKey(const struct Solver* solver, const struct Game* game, bool recycled) {
+    unsigned long long key = solver->salt ^ (solver->loss ? zobrist.goal : 0);
+    for (int seat = 0; seat < game->numPlayers; seat++) {
+        const struct Hand* hand = &game->seats[seat].hand;
+        for (unsigned long long mask = hand->mask; mask != 0; mask &= mask - 1) {
+            int card = __builtin_ctzll(mask);
+            key ^= zobrist.hands[seat][card][hand->counts[card]];
+        }
+    }
+    const struct Deck* discardPile = game->discardPile;
+    key ^= zobrist.topCard[discardPile->cards[discardPile->count - 1]];
+    key ^= zobrist.activeColor[game->activeColor];
+    key ^= zobrist.seat[game->currentPlayer->seat];
+    key ^= game->direction < 0 ? zobrist.reversed : 0;
+    key ^= zobrist.drawnCard[game->drawnCard + 1];
+    key ^= zobrist.pendingDraw[game->pendingDraw & 63];
+    key ^= zobrist.pileCounts[0][game->deck->count] ^ zobrist.pileCounts[1][discardPile->count];
+    for (int i = 0; recycled && i < game->deck->count; i++) {
+        key ^= zobrist.deck[i][game->deck->cards[i]];
+    }
+    unsigned long long state = game->rng.s[0];
+    for (int k = 1; k < 4; k++) {
+        state = splitMix64(&state) ^ game->rng.s[k];
+    }
+    return key ^ splitMix64(&state);
+}
+
+// Function to look a position up in the transposition table. A proof or disproof found through a
+// recycle is not trusted, nor a disproof cut by the horizon when more plies are left now.
+static void probeSolverTable(struct SolverNode* node, int pliesLeft) {
+    struct SolverEntry* entry = &solverTable[node->key & (((size_t)1 << SOLVER_TABLE_BITS) - 1)];
+    unsigned long long data = atomic_load_explicit(&entry->data, memory_order_relaxed);
+    unsigned long long check = atomic_load_explicit(&entry->check, memory_order_relaxed);
+    node->proof = 1;
+    node->disproof = 1;
+    node->horizon = false;
+    node->recycled = false;
+    if (data == 0 || (check ^ data) != node->key) {
+        return;
+    }
+    unsigned int proof = data & SOLVER_INFINITY;
+    unsigned int disproof = data >> 24 & SOLVER_INFINITY;
+    bool horizon = data >> 56 & 1;
+    bool recycled = data >> 57 & 1;
+    if ((proof == 0 || disproof == 0)
+        && (recycled || (disproof == 0 && horizon && (int)(data >> 48 & 0xFF) < pliesLeft))) {
+        return;
+    }
+    node->proof = proof;
+    node->disproof = disproof;
+    node->horizon = horizon;
+    node->recycled = recycled;
+}
+
+// Function to store a position in the transposition table, replacing whatever was in its slot
+static void storeSolverTable(const struct SolverNode* node, int pliesLeft) {
+    struct SolverEntry* entry = &solverTable[node->key & (((size_t)1 << SOLVER_TABLE_BITS) - 1)];
+    unsigned long long data = node->proof | (unsigned long long)node->disproof << 24
+                            | (unsigned long long)pliesLeft << 48 | (unsigned long long)node->horizon << 56
+                            | (unsigned long long)node->recycled << 57;
+    atomic_store_explicit(&entry->check, node->key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&entry->data, data, memory_order_relaxed);
+}
+
+// Function to check if the goal is proven by a finished game
+static bool goalReached(const struct Solver* solver, const struct Game* game) {
+    return (game->winner->seat == solver->rootSeat) != solver->loss;
+}
+
+// Function to list the moves of a position and look up the positions they lead to
+static int expandSolverNode(struct SolverWorker* worker, int ply, int pliesLeft, bool recycled) {
+    struct Solver* solver = worker->solver;
+    struct Game* game = worker->game;
+    struct Move* moves = &worker->moves[ply * MAX_MOVES];
+    struct SolverNode* children = &worker->children[ply * MAX_MOVES];
+    struct Deck* deck = game->deck;
+    int numMoves = listLegalMoves(game, moves);
+    for (int i = 0; i < numMoves; i++) {
+        struct Undo undo;
+        makeMove(game, &moves[i], &worker->undoLog, &undo);
+        struct SolverNode* node = &children[i];
+        bool pilesSwapped = game->deck != deck;
+        // A forced move and the choice that follows a draw extend the search instead of deepening it
+        node->extended = numMoves == 1 || game->drawnCard >= 0;
+        if (game->winner != NULL) {
+            bool reached = goalReached(solver, game);
+            *node = (struct SolverNode){ 0, reached ? 0 : SOLVER_INFINITY, reached ? SOLVER_INFINITY : 0,
+                                         false, pilesSwapped, node->extended };
+        } else if ((pliesLeft == 1 && !node->extended) || ply + 1 == SOLVER_MAX_LINE) {
+            *node = (struct SolverNode){ 0, SOLVER_INFINITY, 0, true, pilesSwapped, node->extended };
+        } else {
+            node->key = positionKey(solver, game, recycled || pilesSwapped);
+            node->proof = SOLVER_UNKNOWN;
+            node->recycled = pilesSwapped;
+            __builtin_prefetch(&solverTable[node->key & (((size_t)1 << SOLVER_TABLE_BITS) - 1)]);
+        }
+        unmakeMove(game, &worker->undoLog, &undo);
+    }
+    // The table is probed once all the keys are known, so the slots of all moves are fetched at once
+    for (int i = 0; i < numMoves; i++) {
+        if (children[i].proof == SOLVER_UNKNOWN) {
+            bool pilesSwapped = children[i].recycled;
+            probeSolverTable(&children[i], pliesLeft - !children[i].extended);
+            children[i].recycled |= pilesSwapped;
+        }
+    }
+    return numMoves;
+}
+
+// Function to search a position until its proof or disproof number reaches its threshold.
+// The player who pursues the goal needs one proven move, the others need every move disproven.
+static void solveNode(struct SolverWorker* worker, int ply, int pliesLeft, unsigned int proofLimit,
+                      unsigned int disproofLimit, bool recycled, struct SolverNode* node) {
+    struct Solver* solver = worker->solver;
+    if (++worker->nodes % SOLVER_POLL_INTERVAL == 0) {
+        if (solver->maxNodes > 0 && (worker->nodes - worker->startNodes) * solver->numThreads >= solver->maxNodes) {
+            atomic_store_explicit(&solver->stop, true, memory_order_relaxed);
+        }
+        worker->aborted = atomic_load_explicit(&solver->stop, memory_order_relaxed);
+    }
+    if (worker->aborted) {
+        return;
+    }
+    struct Game* game = worker->game;
+    struct SolverNode* children = &worker->children[ply * MAX_MOVES];
+    int numMoves = expandSolverNode(worker, ply, pliesLeft, recycled);
+    if (ply == 0) {
+        worker->numRootMoves = numMoves;
+    }
+    bool attacking = (game->currentPlayer->seat == solver->rootSeat) != solver->loss;
+    int shift = worker->index * (ply + 1);
+    while (1) {
+        // The proof number of the player pursuing the goal is that of their easiest move and their
+        // disproof number the sum over all moves; the other way round for the players defending
+        unsigned long long sum = 0;
+        unsigned int least = SOLVER_INFINITY;
+        unsigned int second = SOLVER_INFINITY;
+        int best = 0;
+        node->horizon = false;
+        node->recycled = false;
+        for (int k = 0; k < numMoves; k++) {
+            int i = (k + shift) % numMoves;
+            unsigned int own = attacking ? children[i].proof : children[i].disproof;
+            sum += attacking ? children[i].disproof : children[i].proof;
+            if (own < least) {
+                second = least;
+                least = own;
+                best = i;
+            } else if (own < second) {
+                second = own;
+            }
+            node->horizon |= children[i].horizon;
+            node->recycled |= children[i].recycled;
+        }
+        unsigned int total = sum < SOLVER_INFINITY ? (unsigned int)sum : SOLVER_INFINITY;
+        node->proof = attacking ? least : total;
+        node->disproof = attacking ? total : least;
+        if (node->proof >= proofLimit || node->disproof >= disproofLimit) {
+            break;
+        }
+
+        // Search the most promising move until it is well behind the next one (the 1 + epsilon trick,
+        // which saves switching back and forth between two moves of about the same promise)
+        struct SolverNode* child = &children[best];
+        unsigned long long widened = second + second / 4 + 1;
+        unsigned int limit = widened < SOLVER_INFINITY ? (unsigned int)widened : SOLVER_INFINITY;
+        unsigned int childProof, childDisproof;
+        if (attacking) {
+            childProof = proofLimit < limit ? proofLimit : limit;
+            childDisproof = disproofLimit - node->disproof + child->disproof;
+        } else {
+            childProof = proofLimit - node->proof + child->proof;
+            childDisproof = disproofLimit < limit ? disproofLimit : limit;
+        }
+        struct Deck* deck = game->deck;
+        struct Undo undo;
+        makeMove(game, &worker->moves[ply * MAX_MOVES + best], &worker->undoLog, &undo);
+        bool pilesSwapped = game->deck != deck;
+        solveNode(worker, ply + 1, pliesLeft - !child->extended, childProof, childDisproof,
+                  recycled || pilesSwapped, child);
+        unmakeMove(game, &worker->undoLog, &undo);
+        child->recycled |= pilesSwapped;
+        if (worker->aborted) {
+            return;
+        }
+    }
+    storeSolverTable(node, pliesLeft);
+}
+
+// Function run by each solver thread: one search for each goal, until the root is proven or
+// disproven or, for a helper, the first thread is done
+static void* solverWorker(void* arg) {
+    struct SolverWorker* worker = (struct SolverWorker*)arg;
+    struct Solver* solver = worker->solver;
+    worker->root = (struct SolverNode){ positionKey(solver, worker->game, false), 1, 1, false, false, false };
+    worker->startNodes = worker->nodes;
+    worker->aborted = false;
+    solveNode(worker, 0, solver->maxPlies, SOLVER_INFINITY, SOLVER_INFINITY, false, &worker->root);
+    if (worker->index == 0) {
+        atomic_store(&solver->stop, true);
+    }
+    return NULL;
+}
+
+// Function to solve a position in which every card is known, at a table of up to MAX_PLAYERS players
+// (one deck). Returns its value for the player to move:
+// 1 if they can force a win, -1 if the others can force them to lose, 0 if neither shows within maxPlies
+int solveEndgame(const struct Game* game, int maxPlies, long maxNodes, int numThreads, struct SolveResult* result) {
+    pthread_once(&solverOnce, initSolver);
+    double start = getTime();
+    struct Solver solver;
+    solver.rootSeat = game->currentPlayer->seat;
+    solver.maxPlies = maxPlies < 1 ? 1 : (maxPlies > SOLVER_MAX_PLIES ? SOLVER_MAX_PLIES : maxPlies);
+    solver.maxNodes = maxNodes;
+    unsigned long long count = atomic_fetch_add(&solverCount, 1);
+    solver.salt = splitMix64(&count);
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+    solver.numThreads = numThreads;
+
+    struct SolverWorker* workers = (struct SolverWorker*)calloc(numThreads, sizeof(struct SolverWorker));
+    for (int i = 0; i < numThreads; i++) {
+        workers[i].solver = &solver;
+        workers[i].index = i;
+        workers[i].game = cloneGame(game);
+        initUndoLog(&workers[i].undoLog);
+        workers[i].moves = (struct Move*)malloc((size_t)SOLVER_MAX_LINE * MAX_MOVES * sizeof(struct Move));
+        workers[i].children = (struct SolverNode*)malloc((size_t)SOLVER_MAX_LINE * MAX_MOVES * sizeof(struct SolverNode));
+    }
+    result->value = 0;
+    result->complete = true;
+    result->move = (struct Move){ MOVE_PASS, NO_CARD, SPECIAL };
+    if (listLegalMoves(workers[0].game, workers[0].moves) > 0) {
+        result->move = workers[0].moves[0];
+    }
+    if (game->winner != NULL) {
+        result->value = game->winner->seat == solver.rootSeat ? 1 : -1;
+    }
+    // First try to prove a win, then a loss
+    for (int goal = 0; goal < 2 && result->value == 0; goal++) {
+        solver.loss = goal == 1;
+        atomic_init(&solver.stop, false);
+        for (int i = 1; i < numThreads; i++) {
+            pthread_create(&workers[i].thread, NULL, solverWorker, &workers[i]);
+        }
+        solverWorker(&workers[0]);
+        for (int i = 1; i < numThreads; i++) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        struct SolverNode* root = &workers[0].root;
+        if (root->proof == 0 && !workers[0].aborted) {
+            result->value = solver.loss ? -1 : 1;
+        }
+        result->complete &= !workers[0].aborted;
+        // Play the move closest to a win: the winning move, or else the one with the least proof number
+        for (int i = 0, least = -1; !solver.loss && i < workers[0].numRootMoves; i++) {
+            struct SolverNode* child = &workers[0].children[i];
+            if (least < 0 || child->proof < workers[0].children[least].proof) {
+                least = i;
+                result->move = workers[0].moves[i];
+            }
+        }
+    }
+
+    result->nodes = 0;
+    for (int i = 0; i < numThreads; i++) {
+        result->nodes += workers[i].nodes;
+        freeGame(workers[i].game);
+        freeUndoLog(&workers[i].undoLog);
+        free(workers[i].moves);
+        free(workers[i].children);
+    }
+    free(workers);
+    result->seconds = getTime() - start;
+    return result->value;
+}
+
+// Function to solve the game saved in a file and print what was found
+int runSolver(const char* path, int maxPlies, long maxNodes, int numThreads) {
+    struct Game* game = loadGameFromFile(path, false);
+    if (game == NULL) {
+        fprintf(stderr, "Could not load a saved game from %s.\n", path);
+        return 1;
+    }
+    if (game->winner != NULL) {
+        printf("The game is over, %s won.\n", game->winner->name);
+        freeGame(game);
+        return 0;
+    }
+    struct SolveResult result;
+    solveEndgame(game, maxPlies, maxNodes, numThreads, &result);
+    const char* player = game->currentPlayer->name;
+    if (result.value > 0) {
+        printf("%s to move can force a win.\n", player);
+    } else if (result.value < 0) {
+        printf("%s to move loses whatever they play.\n", player);
+    } else if (result.complete) {
+        printf("%s to move: no forced result within %d plies.\n", player, maxPlies);
+    } else {
+        printf("%s to move: no forced result found in %ld positions per goal.\n", player, maxNodes);
+    }
+    if (result.move.kind == MOVE_PLAY) {
+        enum Color color = cardColor(result.move.card);
+        printf("Best move: play [%s, %s]", getColorName(color), getTypeName(cardType(result.move.card)));
+        if (color == SPECIAL) {
+            printf(" and choose %s", getColorName(result.move.color));
+        }
+        printf(".\n");
+    } else {
+        printf("Best move: %s.\n", result.move.kind == MOVE_DRAW ? "draw a card" : "keep the drawn card");
+    }
+    printf("Searched %ld positions on %d threads in %.3f s (%.0f positions/s).\n", result.nodes,
+           numThreads < 1 ? 1 : numThreads, result.seconds, result.nodes / (result.seconds > 0 ? result.seconds : 1e-9));
+    freeGame(game);
+    return 0;
+}
+
+// Function to play one game between bots and add it to the totals, returns the winning seat (-1 for none)
+static int simulateGame(unsigned long long seed, int numPlayers, const enum StrategyKind* kinds, unsigned int rules,
+                         struct Move* moves, struct SimStats* stats, struct GameLog* log, struct EventBus* events) {
+    static const char* names[MAX_PLAYERS] = {
+        "Bot1", "Bot2", "Bot3", "Bot4", "Bot5", "Bot6", "Bot7", "Bot8", "Bot9", "Bot10"
+    };
+    struct Game* game = createGame(names, numPlayers, false, seed);
+    game->rules = rules;
+    struct Strategy strategies[MAX_PLAYERS];
+    for (int seat = 0; seat < numPlayers; seat++) {
+        initStrategy(&strategies[seat], kinds[seat], gameSeed(seed, seat + 1), &searchBudget);
+        game->seats[seat].strategy = &strategies[seat];
+    }
+    if (log != NULL) {
+        beginGameLog(log, game, seed);
+    }
+    game->events = events;
+    while (getWinner(game) == NULL && game->turns < MAX_TURNS) {
+        TELEMETRY_START(turnStart);
+        struct Player* player = game->currentPlayer;
+        int numMoves = listLegalMoves(game, moves);
+        TELEMETRY_STOP(TELEMETRY_MOVEGEN_NS, turnStart);
+        struct Move move = player->strategy->chooseMove(player->strategy, game, moves, numMoves);
+        applyMove(game, &move);
+        TELEMETRY_STOP(TELEMETRY_TURN_NS, turnStart);
+    }
+    TELEMETRY_COUNT(TELEMETRY_GAMES, 1);
+    TELEMETRY_COUNT(TELEMETRY_TURNS, game->turns);
+    TELEMETRY_RECORD(TELEMETRY_TURNS_PER_GAME, game->turns);
+    for (int seat = 0; seat < numPlayers; seat++) {
+        stats->playouts += strategies[seat].playouts;
+    }
+    if (log != NULL) {
+        endGameLog(game);
+    }
+    if (events != NULL) {
+        events->game++;
+    }
+    if (getWinner(game) == NULL) {
+        stats->unfinished++;
+    } else {
+        stats->wins[getWinner(game)->seat]++;
+    }
+    stats->games++;
+    stats->turns += game->turns;
+    int winner = getWinner(game) == NULL ? -1 : getWinner(game)->seat;
+    freeGame(game);
+    return winner;
+}
+
+// Define a round-robin tournament of heads-up games between strategies. Every pairing plays each
+// deal twice with the seats swapped, so the luck of the deal cancels out.
+struct Tournament {
+    int numEntrants;
+    enum StrategyKind entrants[MAX_ENTRANTS];
+    int numPairings;
+    int pairings[MAX_PAIRINGS][2];       // Entrants of each pairing
+    unsigned int rules;
+    unsigned long long seed;
+    long maxGames;
+    atomic_long nextGame;                // Index of the next game nobody has claimed yet
+    atomic_bool stop;                    // Set once the ranking is settled
+};
+
+// Define the results of one tournament thread. Only the thread writes them, the main thread sums
+// the results of all threads while they run, without locks.
+struct TournamentWorker {
+    pthread_t thread;
+    struct Tournament* tournament;
+    atomic_long results[MAX_PAIRINGS][3]; // Wins of the first and second entrant of each pairing, then unfinished games
+};
+
+// Function run by each tournament thread: play claimed games until the end or the ranking is settled.
+// Game i is deal i / 2 of pairing (i / 2) % pairings, the second game of a deal with the seats swapped.
+static void* tournamentWorker(void* arg) {
+    struct TournamentWorker* worker = (struct TournamentWorker*)arg;
+    struct Tournament* tournament = worker->tournament;
+    struct Move* moves = (struct Move*)malloc(MAX_MOVES * sizeof(struct Move));
+    struct SimStats stats = { 0 };
+    while (!atomic_load_explicit(&tournament->stop, memory_order_relaxed)) {
+        long first = atomic_fetch_add(&tournament->nextGame, TOURNAMENT_CHUNK);
+        if (first >= tournament->maxGames) {
+            break;
+        }
+        long last = first + TOURNAMENT_CHUNK < tournament->maxGames ? first + TOURNAMENT_CHUNK : tournament->maxGames;
+        for (long i = first; i < last; i++) {
+            int pairing = (int)((i / 2) % tournament->numPairings);
+            int swapped = (int)(i & 1);
+            enum StrategyKind kinds[2] = {
+                tournament->entrants[tournament->pairings[pairing][swapped]],
+                tournament->entrants[tournament->pairings[pairing][!swapped]]
+            };
+            int winner = simulateGame(gameSeed(tournament->seed, i / 2), 2, kinds, tournament->rules, moves, &stats, NULL, NULL);
+            int result = winner < 0 ? 2 : winner ^ swapped;
+            atomic_fetch_add_explicit(&worker->results[pairing][result], 1, memory_order_relaxed);
+        }
+    }
+    free(moves);
+    return NULL;
+}
+
+// Function to rate the entrants from the results of every pairing: Bradley-Terry strengths fitted by
+// minorization-maximization, on the Elo scale around 1500, with their standard errors. Unfinished games
+// count as draws, and every pairing gets one draw more so that a strategy that never wins keeps a rating.
+static void rateEntrants(const struct Tournament* tournament, const long results[][3], double* elo, double* error) {
+    int n = tournament->numEntrants;
+    double games[MAX_ENTRANTS][MAX_ENTRANTS] = { { 0 } };
+    double score[MAX_ENTRANTS] = { 0 };
+    for (int p = 0; p < tournament->numPairings; p++) {
+        int a = tournament->pairings[p][0];
+        int b = tournament->pairings[p][1];
+        double played = results[p][0] + results[p][1] + results[p][2] + 1;
+        games[a][b] += played;
+        games[b][a] += played;
+        score[a] += results[p][0] + 0.5 * (results[p][2] + 1);
+        score[b] += results[p][1] + 0.5 * (results[p][2] + 1);
+    }
+
+    double strength[MAX_ENTRANTS];
+    for (int i = 0; i < n; i++) {
+        strength[i] = 1.0;
+    }
+    for (int iteration = 0; iteration < 1000; iteration++) {
+        double change = 0;
+        double logSum = 0;
+        for (int i = 0; i < n; i++) {
+            double sum = 0;
+            for (int j = 0; j < n; j++) {
+                if (j != i && games[i][j] > 0) {
+                    sum += games[i][j] / (strength[i] + strength[j]);
+                }
+            }
+            double updated = score[i] / sum;
+            change = fmax(change, fabs(log(updated / strength[i])));
+            strength[i] = updated;
+            logSum += log(updated);
+        }
+        // Keep the geometric mean at 1
+        for (int i = 0; i < n; i++) {
+            strength[i] /= exp(logSum / n);
+        }
+        if (change < 1e-9) {
+            break;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        double information = 0;
+        for (int j = 0; j < n; j++) {
+            if (j != i) {
+                double p = strength[i] / (strength[i] + strength[j]);
+                information += games[i][j] * p * (1 - p);
+            }
+        }
+        elo[i] = 1500 + 400 * log10(strength[i]);
+        error[i] = 400 / log(10) / sqrt(information);
+    }
+}
+
+// Function to order the entrants by rating, best first
+static void rankEntrants(const double* elo, int numEntrants, int* order) {
+    for (int i = 0; i < numEntrants; i++) {
+        int j = i;
+        for (; j > 0 && elo[order[j - 1]] < elo[i]; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+}
+
+// Function to check if the ranking is settled: every pairing played enough games and every entrant
+// is rated apart from the next one down by more than 2.58 standard errors of their difference
+static bool rankingSettled(const struct Tournament* tournament, const long results[][3], const double* elo,
+                           const double* error) {
+    for (int p = 0; p < tournament->numPairings; p++) {
+        if (results[p][0] + results[p][1] + results[p][2] < TOURNAMENT_MIN_GAMES) {
+            return false;
+        }
+    }
+    int order[MAX_ENTRANTS];
+    rankEntrants(elo, tournament->numEntrants, order);
+    for (int rank = 1; rank < tournament->numEntrants; rank++) {
+        int above = order[rank - 1];
+        int below = order[rank];
+        if (elo[above] - elo[below] <= 2.58 * sqrt(error[above] * error[above] + error[below] * error[below])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to run a tournament between the strategies of a comma separated list, on all threads,
+// and print the ratings. The run stops after maxGames games, or earlier once the ranking is settled.
+int runTournament(const char* list, long maxGames, int numThreads, unsigned long long seed, unsigned int rules) {
+    struct Tournament tournament;
+    tournament.numEntrants = 0;
+    char* copy = strdup(list);
+    for (char* token = strtok(copy, ","); token != NULL; token = strtok(NULL, ",")) {
+        enum StrategyKind kind;
+        if (!parseStrategyKind(token, &kind) || kind == STRATEGY_HUMAN || tournament.numEntrants == MAX_ENTRANTS) {
+            fprintf(stderr, "A tournament needs 2 to %d bot kinds, %s is not one.\n", MAX_ENTRANTS, token);
+            free(copy);
+            return 1;
+        }
+        tournament.entrants[tournament.numEntrants++] = kind;
+    }
+    free(copy);
+    if (tournament.numEntrants < 2) {
+        fprintf(stderr, "A tournament needs 2 to %d bot kinds.\n", MAX_ENTRANTS);
+        return 1;
+    }
+    tournament.numPairings = 0;
+    for (int i = 0; i < tournament.numEntrants; i++) {
+        for (int j = i + 1; j < tournament.numEntrants; j++) {
+            tournament.pairings[tournament.numPairings][0] = i;
+            tournament.pairings[tournament.numPairings][1] = j;
+            tournament.numPairings++;
+        }
+    }
+    tournament.rules = rules;
+    tournament.seed = seed;
+    tournament.maxGames = maxGames;
+    atomic_init(&tournament.nextGame, 0);
+    atomic_init(&tournament.stop, false);
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+    if (searchBudget.threads < 1) {
+        searchBudget.threads = 1;
+    }
+
+    struct TournamentWorker* workers = (struct TournamentWorker*)calloc(numThreads, sizeof(struct TournamentWorker));
+    double start = getTime();
+    for (int i = 0; i < numThreads; i++) {
+        workers[i].tournament = &tournament;
+        pthread_create(&workers[i].thread, NULL, tournamentWorker, &workers[i]);
+    }
+
+    // Sum the results of all threads every 100 ms until the games run out or the ranking is settled
+    long results[MAX_PAIRINGS][3];
+    double elo[MAX_ENTRANTS];
+    double error[MAX_ENTRANTS];
+    long played;
+    bool settled = false;
+    while (1) {
+        bool finished = atomic_load(&tournament.nextGame) >= maxGames;
+        if (finished) {
+            for (int i = 0; i < numThreads; i++) {
+                pthread_join(workers[i].thread, NULL);
+            }
+        } else {
+            usleep(100000);
+        }
+        memset(results, 0, sizeof(results));
+        played = 0;
+        for (int i = 0; i < numThreads; i++) {
+            for (int p = 0; p < tournament.numPairings; p++) {
+                for (int k = 0; k < 3; k++) {
+                    long count = atomic_load_explicit(&workers[i].results[p][k], memory_order_relaxed);
+                    results[p][k] += count;
+                    played += count;
+                }
+            }
+        }
+        rateEntrants(&tournament, results, elo, error);
+        if (finished) {
+            break;
+        }
+        if (rankingSettled(&tournament, results, elo, error)) {
+            settled = true;
+            atomic_store(&tournament.stop, true);
+            // Count the games already under way as well
+            atomic_store(&tournament.nextGame, maxGames);
+        }
+    }
+    double elapsed = getTime() - start;
+    free(workers);
+
+    printf("Tournament of %d bots, %ld heads-up games on %d threads in %.3f s, seed %llu: %s\n",
+           tournament.numEntrants, played, numThreads, elapsed, seed,
+           settled ? "stopped once the ranking was settled" : "ranking not settled yet");
+    printf("Rank  Bot        Elo    95%% CI  Score   Games\n");
+    int order[MAX_ENTRANTS];
+    rankEntrants(elo, tournament.numEntrants, order);
+    for (int rank = 1; rank <= tournament.numEntrants; rank++) {
+        int best = order[rank - 1];
+        double score = 0;
+        long games = 0;
+        for (int p = 0; p < tournament.numPairings; p++) {
+            for (int side = 0; side < 2; side++) {
+                if (tournament.pairings[p][side] == best) {
+                    score += results[p][side] + 0.5 * results[p][2];
+                    games += results[p][0] + results[p][1] + results[p][2];
+                }
+            }
+        }
+        printf("%-5d %-9s %5.0f  %6.1f  %5.1f%%  %ld\n", rank, strategyNames[tournament.entrants[best]], elo[best],
+               1.96 * error[best], games > 0 ? 100.0 * score / games : 0.0, games);
+    }
+    return 0;
+}
+
+// Define a batch of games in struct-of-arrays form: one array per field, indexed by the slot of the game
+// (and by seat for the hands), so that each pass of the batch engine is a loop over games.
+// The games are played by scripted players, exactly as simulateGame plays them.
+struct GameBatch {
+    int numPlayers;
+    unsigned long long rng[4][BATCH_SIZE];              // Generator state of every game, one word per array
+    unsigned char piles[BATCH_SIZE][2][DECK_SIZE];      // Storage of the two piles of every game
+    unsigned char deckPile[BATCH_SIZE];                 // Pile holding the deck, the other one is discarded on
+    int deckCount[BATCH_SIZE];
+    int discardCount[BATCH_SIZE];
+    unsigned char counts[BATCH_SIZE][MAX_PLAYERS][NUM_CARD_IDS]; // Copies held of each card id
+    unsigned long long handMask[MAX_PLAYERS][BATCH_SIZE];        // Card ids held at least once
+    int handSize[MAX_PLAYERS][BATCH_SIZE];
+    int colorCounts[MAX_PLAYERS][SPECIAL][BATCH_SIZE];  // Colored cards held of each color, for Wilds
+    unsigned char topCard[BATCH_SIZE];                  // Top card of the discard pile
+    unsigned char activeColor[BATCH_SIZE];
+    int seat[BATCH_SIZE];                               // Seat of the current player
+    int direction[BATCH_SIZE];
+    int turns[BATCH_SIZE];
+    long gameIndex[BATCH_SIZE];                         // Game played in the slot, -1 for an empty slot
+    unsigned char choice[BATCH_SIZE];                   // Card to play this pass, NO_CARD to draw
+};
+
+// Function to get the next number of the generator of one game (the same sequence as rngNext)
+static inline unsigned long long laneNext(struct GameBatch* batch, int g) {
+    unsigned long long s0 = batch->rng[0][g];
+    unsigned long long s1 = batch->rng[1][g];
+    unsigned long long s2 = batch->rng[2][g];
+    unsigned long long s3 = batch->rng[3][g];
+    unsigned long long result = rotl(s1 * 5, 7) * 9;
+    unsigned long long t = s1 << 17;
+    s2 ^= s0;
+    s3 ^= s1;
+    s1 ^= s2;
+    s0 ^= s3;
+    s2 ^= t;
+    batch->rng[0][g] = s0;
+    batch->rng[1][g] = s1;
+    batch->rng[2][g] = s2;
+    batch->rng[3][g] = rotl(s3, 45);
+    return result;
+}
+
+// Function to get a number below bound from the generator of one game (the same sequence as rngBounded)
+static inline unsigned int laneBounded(struct GameBatch* batch, int g, unsigned int bound) {
+    unsigned long long m = (laneNext(batch, g) >> 32) * bound;
+    unsigned int low = (unsigned int)m;
+    if (low < bound) {
+        unsigned int threshold = -bound % bound;
+        while (low < threshold) {
+            m = (laneNext(batch, g) >> 32) * bound;
+            low = (unsigned int)m;
+        }
+    }
+    return (unsigned int)(m >> 32);
+}
+
+// Function to add a card to a hand of a game in the batch
+static inline void laneAddCard(struct GameBatch* batch, int g, int seat, unsigned char card) {
+    batch->counts[g][seat][card]++;
+    batch->handMask[seat][g] |= CARD_BIT(card);
+    batch->handSize[seat][g]++;
+    if (card < CARD(SPECIAL, 0)) {
+        batch->colorCounts[seat][card / 13][g]++;
+    }
+}
+
+// Function to remove a card from a hand of a game in the batch
+static inline void laneRemoveCard(struct GameBatch* batch, int g, int seat, unsigned char card) {
+    if (--batch->counts[g][seat][card] == 0) {
+        batch->handMask[seat][g] &= ~CARD_BIT(card);
+    }
+    batch->handSize[seat][g]--;
+    if (card < CARD(SPECIAL, 0)) {
+        batch->colorCounts[seat][card / 13][g]--;
+    }
+}
+
+// Function to take a random card from the deck of a game in the batch, as takeRandomCard does
+static inline unsigned char laneTakeCard(struct GameBatch* batch, int g) {
+    unsigned char* deck = batch->piles[g][batch->deckPile[g]];
+    int i = laneBounded(batch, g, batch->deckCount[g]);
+    unsigned char card = deck[i];
+    deck[i] = deck[--batch->deckCount[g]];
+    return card;
+}
+
+// Function to draw a card for a seat of a game in the batch, as drawCard does. Returns -1 when there is
+// no card left to draw.
+static int laneDraw(struct GameBatch* batch, int g, int seat) {
+    if (batch->deckCount[g] == 0) {
+        int count = batch->discardCount[g] - 1;
+        if (count <= 0) {
+            return -1;
+        }
+        // Swap the piles, the top card stays in play
+        unsigned char* discardPile = batch->piles[g][batch->deckPile[g] ^ 1];
+        batch->piles[g][batch->deckPile[g]][0] = discardPile[count];
+        batch->deckPile[g] ^= 1;
+        batch->deckCount[g] = count;
+        batch->discardCount[g] = 1;
+    }
+    unsigned char card = laneTakeCard(batch, g);
+    laneAddCard(batch, g, seat, card);
+    return card;
+}
+
+// Function to start games in empty slots of the batch, as createGame does. The hands of the new games
+// are dealt by the batch shuffle kernel: taking a random card and moving the last one into its place is
+// a step of Fisher-Yates, so the last steps of a shuffle leave the dealt cards at the end of each deck
+// and the rest of the deck as the deal would.
+static void startBatchGames(struct GameBatch* batch, const int* slots, int numSlots, unsigned long long masterSeed) {
+    int numPlayers = batch->numPlayers;
+    for (int k = 0; k < numSlots; k++) {
+        int g = slots[k];
+        struct Rng rng;
+        rngSeed(&rng, gameSeed(masterSeed, batch->gameIndex[g]));
+        for (int word = 0; word < 4; word++) {
+            batch->rng[word][g] = rng.s[word];
+        }
+        memcpy(batch->piles[g][0], canonicalDeck, DECK_SIZE);
+        batch->deckPile[g] = 0;
+        batch->deckCount[g] = DECK_SIZE;
+        memset(batch->counts[g], 0, sizeof(batch->counts[g]));
+        for (int seat = 0; seat < numPlayers; seat++) {
+            batch->handMask[seat][g] = 0;
+            batch->handSize[seat][g] = 0;
+            for (enum Color color = RED; color <= YELLOW; color++) {
+                batch->colorCounts[seat][color][g] = 0;
+            }
+        }
+    }
+    int dealt = numPlayers * CARDS_PER_PLAYER;
+    struct ShuffleLanes lanes;
+    for (int first = 0; first < numSlots; first += SHUFFLE_LANES) {
+        memset(&lanes, 0, sizeof(lanes));
+        lanes.numLanes = numSlots - first < SHUFFLE_LANES ? numSlots - first : SHUFFLE_LANES;
+        for (int k = 0; k < lanes.numLanes; k++) {
+            int g = slots[first + k];
+            lanes.cards[k] = batch->piles[g][0];
+            for (int word = 0; word < 4; word++) {
+                lanes.s[word][k] = batch->rng[word][g];
+            }
+        }
+        shuffleLanes(&lanes, DECK_SIZE, dealt);
+        for (int k = 0; k < lanes.numLanes; k++) {
+            int g = slots[first + k];
+            for (int word = 0; word < 4; word++) {
+                batch->rng[word][g] = lanes.s[word][k];
+            }
+            batch->deckCount[g] = DECK_SIZE - dealt;
+            for (int i = 0; i < dealt; i++) {
+                laneAddCard(batch, g, i / CARDS_PER_PLAYER, lanes.cards[k][DECK_SIZE - 1 - i]);
+            }
+        }
+    }
+
+    for (int k = 0; k < numSlots; k++) {
+        int g = slots[k];
+        // Start the discard pile with a random card that is not a Wild or action card
+        unsigned char* deck = batch->piles[g][0];
+        int top;
+        do {
+            top = laneBounded(batch, g, batch->deckCount[g]);
+        } while (isActionCard(cardColor(deck[top]), cardType(deck[top])));
+        unsigned char topCard = deck[top];
+        deck[top] = deck[--batch->deckCount[g]];
+        batch->piles[g][1][0] = topCard;
+        batch->discardCount[g] = 1;
+        batch->activeColor[g] = cardColor(topCard);
+        batch->topCard[g] = topCard;
+        batch->seat[g] = 0;
+        batch->direction[g] = 1;
+        batch->turns[g] = 0;
+    }
+}
+
+// Function to get the seat after another one in the direction of play
+static inline int nextSeat(struct GameBatch* batch, int g, int seat) {
+    seat += batch->direction[g];
+    return seat < 0 ? seat + batch->numPlayers : (seat == batch->numPlayers ? 0 : seat);
+}
+
+// Function to play a card for the current player of a game in the batch and apply its effect,
+// as playCard does. Returns true when the player won.
+static bool lanePlay(struct GameBatch* batch, int g, unsigned char card) {
+    int seat = batch->seat[g];
+    enum Color color = cardColor(card);
+    enum Type type = cardType(card);
+    if (color == SPECIAL) {
+        // The color held the most, the first one on a tie
+        color = RED;
+        for (enum Color other = BLUE; other <= YELLOW; other++) {
+            if (batch->colorCounts[seat][other][g] > batch->colorCounts[seat][color][g]) {
+                color = other;
+            }
+        }
+    }
+    laneRemoveCard(batch, g, seat, card);
+    batch->piles[g][batch->deckPile[g] ^ 1][batch->discardCount[g]++] = card;
+    batch->activeColor[g] = color;
+    batch->topCard[g] = card;
+    if (batch->handSize[seat][g] == 0) {
+        return true;
+    }
+
+    switch (type) {
+        case SKIP:
+            seat = nextSeat(batch, g, seat);
+            break;
+        case REVERSE:
+            batch->direction[g] = -batch->direction[g];
+            break;
+        case WILD_DRAW:
+        case DRAW_TWO: {
+            int victim = nextSeat(batch, g, seat);
+            for (int i = type == WILD_DRAW ? 4 : 2; i > 0; i--) {
+                laneDraw(batch, g, victim);
+            }
+            seat = victim;
+            break;
+        }
+        default:
+            break;
+    }
+    batch->seat[g] = seat;
+    return false;
+}
+
+// Function to play one turn in every game of the batch. The first pass picks the card of every game
+// from its masks only, a loop over games with no branches; the second pass applies the moves.
+// Returns the number of slots whose game ended, listed in finished.
+static int stepBatch(struct GameBatch* batch, int* finished, struct SimStats* stats) {
+    unsigned long long hands[BATCH_SIZE];
+    unsigned long long playable[BATCH_SIZE];
+    for (int g = 0; g < BATCH_SIZE; g++) {
+        hands[g] = batch->handMask[batch->seat[g]][g];
+    }
+    legalMoveMasks(hands, batch->topCard, batch->activeColor, playable, BATCH_SIZE);
+    for (int g = 0; g < BATCH_SIZE; g++) {
+        batch->choice[g] = playable[g] != 0 ? __builtin_ctzll(playable[g]) : NO_CARD;
+    }
+
+    int numFinished = 0;
+    for (int g = 0; g < BATCH_SIZE; g++) {
+        if (batch->gameIndex[g] < 0) {
+            continue;
+        }
+        int seat = batch->seat[g];
+        int card = batch->choice[g];
+        if (card == NO_CARD) {
+            // Draw, and play the card drawn when it can be played
+            card = laneDraw(batch, g, seat);
+            if (card >= 0 && legalMoveMask(CARD_BIT(card), batch->topCard[g], batch->activeColor[g]) == 0) {
+                card = -1;
+            }
+        }
+        if (card >= 0 && lanePlay(batch, g, card)) {
+            stats->wins[seat]++;
+        } else {
+            batch->seat[g] = nextSeat(batch, g, batch->seat[g]);
+            if (++batch->turns[g] < MAX_TURNS) {
+                continue;
+            }
+            stats->unfinished++;
+        }
+        stats->games++;
+        stats->turns += batch->turns[g];
+        batch->gameIndex[g] = -1;
+        finished[numFinished++] = g;
+    }
+    return numFinished;
+}
+
+// Define the work of one simulation thread
+struct SimWorker {
+    pthread_t thread;
+    long numGames;
+    int numPlayers;
+    const enum StrategyKind* kinds; // Bot of each seat
+    unsigned int rules;      // House rules of every game
+    unsigned long long masterSeed;
+    atomic_long* nextGame;   // Index of the next game nobody has claimed yet
+    struct LogWriter* writer; // Replay log shared by all workers, NULL when not logging
+    struct EventBus* events; // Table of the worker's games, NULL when nobody listens
+    bool batched;            // Play the games with the batch engine
+    struct SimStats stats;   // Totals of the games this worker played
+};
+
+// Function run by each simulation thread with the batch engine: keep the batch full with games
+// claimed in chunks, starting a new game in every slot whose game ended
+static void simulateBatchWorker(struct SimWorker* worker) {
+    struct GameBatch* batch = (struct GameBatch*)malloc(sizeof(struct GameBatch));
+    batch->numPlayers = worker->numPlayers;
+    // Empty slots still go through the first pass, give them a valid state
+    memset(batch->handMask, 0, sizeof(batch->handMask));
+    memset(batch->seat, 0, sizeof(batch->seat));
+    memset(batch->activeColor, 0, sizeof(batch->activeColor));
+    memset(batch->topCard, 0, sizeof(batch->topCard));
+    int emptySlots[BATCH_SIZE];
+    int numFree = BATCH_SIZE;
+    for (int g = 0; g < BATCH_SIZE; g++) {
+        batch->gameIndex[g] = -1;
+        emptySlots[g] = g;
+    }
+    long next = 0;
+    long last = 0;
+    int numActive = 0;
+    while (1) {
+        // Fill the empty slots with the next games
+        int numStarting = 0;
+        while (numStarting < numFree) {
+            if (next == last) {
+                next = atomic_fetch_add(worker->nextGame, SIMULATION_CHUNK);
+                if (next >= worker->numGames) {
+                    next = last = worker->numGames;
+                    break;
+                }
+                last = next + SIMULATION_CHUNK < worker->numGames ? next + SIMULATION_CHUNK : worker->numGames;
+            }
+            batch->gameIndex[emptySlots[numStarting++]] = next++;
+        }
+        startBatchGames(batch, emptySlots, numStarting, worker->masterSeed);
+        numActive += numStarting;
+        memmove(emptySlots, emptySlots + numStarting, (numFree - numStarting) * sizeof(int));
+        numFree -= numStarting;
+        if (numActive == 0) {
+            break;
+        }
+        int numFinished = stepBatch(batch, emptySlots + numFree, &worker->stats);
+        numFree += numFinished;
+        numActive -= numFinished;
     }
-    return ;
+    free(batch);
 }
 
-// WILD DRAW FOUR function
-void WildDraw (struct Card** deck,struct Player* nextplayer,struct Card* currentcard) {
-Wild(currentcard) ;
-printf("\nPlayer %s Drew The Following Cards:\n", nextplayer->name);
-   for (int i = 0; i < 4; i++) {
-dealCard(deck,nextplayer) ;
-displayLastCard(nextplayer) ;
-printf("\n");
-
-    }  }
-
-// function to handle reverse <3 Working
-void reverseDirection(struct Player* firstPlayer) {
-    struct Player* current = firstPlayer;
-    struct Player* temp = NULL ;
-
-    // swap next and prev pointers for each player
-    do {
-        temp = current->next;
-        current->next = current->prev;
-        current->prev = temp;
-        current = temp; // Move to the next node
-    } while (current != firstPlayer);
-
-    // Update the pointer to the first player
-    firstPlayer = current->prev;
+// Function run by each simulation thread: claim chunks of games until none are left
+static void* simulateWorker(void* arg) {
+    struct SimWorker* worker = (struct SimWorker*)arg;
+    struct Move moves[MAX_MOVES];
+    struct GameLog log;
+    if (worker->writer != NULL) {
+        initGameLog(&log, worker->writer);
+    }
+    while (!worker->batched) {
+        long first = atomic_fetch_add(worker->nextGame, SIMULATION_CHUNK);
+        if (first >= worker->numGames) {
+            break;
+        }
+        long last = first + SIMULATION_CHUNK < worker->numGames ? first + SIMULATION_CHUNK : worker->numGames;
+        for (long i = first; i < last; i++) {
+            simulateGame(gameSeed(worker->masterSeed, i), worker->numPlayers, worker->kinds, worker->rules, moves,
+                         &worker->stats, worker->writer != NULL ? &log : NULL, worker->events);
+        }
+    }
+    if (worker->batched) {
+        simulateBatchWorker(worker);
+    }
+    if (worker->writer != NULL) {
+        freeGameLog(&log);
+    }
+    worker->stats.alloc = allocCounters;
+#ifdef UNO_TELEMETRY
+    worker->stats.telemetry = telemetry;
+#endif
+    return NULL;
 }
 
-//most important function
-void playTurn(struct Card** deck, struct Player** currentPlayer, struct Card** discardPile) {
-    // Print the top card on the pile
-    printf("Top card on the pile: ");
-    printCard(*discardPile);
-    displayHand(*currentPlayer);
+#ifdef UNO_TELEMETRY
+// Names of the counters and histograms, in the order of their enums
+static const char* telemetryCounterNames[TELEMETRY_NUM_COUNTERS] = {
+    "games", "turns", "cards_drawn", "reshuffles", "skips", "reverses", "draw_twos", "wild_draws"
+};
+static const char* telemetryHistogramNames[TELEMETRY_NUM_HISTOGRAMS] = {
+    "turns_per_game", "turn_ns", "movegen_ns"
+};
 
-    while (1) {
-        // Choose a card to play or type "Draw" to draw a card
-        printf("Choose a card to play (enter color and type) or type 'Draw' to draw a card or 'Exit': ");
-        char input[20];
-        scanf("%s", input);
-        // Convert input to lowercase
-        for (int i = 0; input[i]; i++) {
-            input[i] = tolower(input[i]);
-        }
-            // Check if the player wants to exit the game
-        if (strcmp(input, "exit") == 0) {
-            printf("Exiting the game...\n");
-             if (deck != NULL) {
-                    freeDeck(*deck);  // Free the deck
-                    deck = NULL;     // Set deck pointer to NULL after freeing
-                }
-                if (currentPlayer != NULL) {
-                    freePlayerList(*currentPlayer);  // Free the player list
-                    currentPlayer = NULL;            // Set player list pointer to NULL after freeing
-                }
-            exit(0); // Exit the program
+// Function to add the telemetry of one thread to the totals
+static void mergeTelemetry(struct Telemetry* total, const struct Telemetry* thread) {
+    for (int i = 0; i < TELEMETRY_NUM_COUNTERS; i++) {
+        total->counters[i] += thread->counters[i];
+    }
+    for (int h = 0; h < TELEMETRY_NUM_HISTOGRAMS; h++) {
+        for (int b = 0; b < TELEMETRY_BUCKETS; b++) {
+            total->buckets[h][b] += thread->buckets[h][b];
         }
+        total->sums[h] += thread->sums[h];
+    }
+}
 
-        // Convert input to lowercase
-        for (int i = 0; input[i]; i++) {
-            input[i] = tolower(input[i]);
+// Function to print telemetry as JSON or as Prometheus text. Histogram buckets are cumulative
+// in Prometheus and per bucket in JSON, both with the largest value of the bucket as its bound,
+// and stop at the last bucket that is not empty.
+static void printTelemetry(const struct Telemetry* data, const char* format) {
+    bool json = strcmp(format, "json") == 0;
+    if (json) {
+        printf("{\n  \"counters\": {");
+        for (int i = 0; i < TELEMETRY_NUM_COUNTERS; i++) {
+            printf("%s\"%s\": %llu", i == 0 ? "" : ", ", telemetryCounterNames[i], data->counters[i]);
         }
-        // Check if the player chose to draw a card
-        if (strcmp(input, "draw") == 0) {
-                 if (*deck == NULL) {
-        printf("Deck is empty! Shuffling discard pile back into the deck.\\n");
-        *deck = *discardPile;
-        *discardPile = NULL;
-        shuffleDeck(deck); // Reshuffle the deck
-    }
-            dealCard(deck, *currentPlayer);
-            printf("Player %s drew a card.\n", (*currentPlayer)->name);
-            displayLastCard(*currentPlayer);
-            //get last card
-            struct Card* lastcard = (*currentPlayer)->hand;
-            while (lastcard->next != NULL) {
-                lastcard = lastcard->next;
-            }
-            while (1) {
-            if (checkValidMove(*discardPile, lastcard)) {
-                char choice;
-                printf("Do you want to play the card? [Y/N]: ");
-                scanf(" %c", &choice);
-                  if (choice == 'Y' || choice == 'y') {
-                    // Play the card
-                     printf("Player %s played ", (*currentPlayer)->name);
-                    printCard(lastcard);
-                // Remove played card from player's hand
-                removeCardFromHand(*currentPlayer, lastcard);
-                // Put currentcard on top of the deck
-                if ((*discardPile)->type == WILD || (*discardPile)->type == WILD_DRAW) {
-                    (*discardPile)->color = SPECIAL;
-                }
-               struct Card* currentCard = lastcard;
-
-                currentCard->next = *discardPile;
-                *discardPile = currentCard;
-
-                    currentCard->next = *discardPile;
-
-// handle special cards
-                         switch ((*discardPile)->type) {
-
-                        case SKIP:
-SkipTurn(currentPlayer);
-
-                            // Skip the next player's turn
-                            break;
-                        case REVERSE:
-reverseDirection(*currentPlayer);
-   break;
-                        case WILD_DRAW:
-                            WildDraw(deck, (*currentPlayer)->next, *discardPile);
-                                          SkipTurn(currentPlayer);
-
-                            break;
-                        case DRAW_TWO:
-                            Draw_Two(deck, (*currentPlayer)->next);
-                            SkipTurn(currentPlayer);
-
-                            break;
-                        case WILD:
-                            Wild(*discardPile);
-                            break;
-                        default:
-                            break;;}
-
-           } else if (choice == 'N' || choice == 'n'){
-                    printf("Card was not played.\n");
-                    // Continue the turn
-                    return;
-                } else {
-    printf("Invalid choice. Please enter 'Y' or 'N'.\n");
- continue;
-                }
+        printf("},\n  \"histograms\": {\n");
+    }
+    for (int i = 0; !json && i < TELEMETRY_NUM_COUNTERS; i++) {
+        printf("# TYPE uno_%s_total counter\nuno_%s_total %llu\n",
+               telemetryCounterNames[i], telemetryCounterNames[i], data->counters[i]);
+    }
+    for (int h = 0; h < TELEMETRY_NUM_HISTOGRAMS; h++) {
+        const char* name = telemetryHistogramNames[h];
+        int last = 0;
+        unsigned long long count = 0;
+        for (int b = 0; b < TELEMETRY_BUCKETS; b++) {
+            if (data->buckets[h][b] != 0) {
+                last = b;
+            }
+            count += data->buckets[h][b];
+        }
+        if (json) {
+            printf("    \"%s\": {\"count\": %llu, \"sum\": %llu, \"buckets\": [", name, count, data->sums[h]);
+        } else {
+            printf("# TYPE uno_%s histogram\n", name);
+        }
+        unsigned long long cumulative = 0;
+        for (int b = 0; b <= last; b++) {
+            unsigned long long bound = b == 64 ? ~0ULL : (1ULL << b) - 1;
+            cumulative += data->buckets[h][b];
+            if (json) {
+                printf("%s[%llu, %llu]", b == 0 ? "" : ", ", bound, data->buckets[h][b]);
             } else {
-                printf("Card is not playable.\n");
-                // Continue the turn
-                break;
+                printf("uno_%s_bucket{le=\"%llu\"} %llu\n", name, bound, cumulative);
             }
-            return ;
-        } return;}
-        for (int i = 0; input[i]; i++) {
-            input[i] = tolower(input[i]);
         }
-        // Convert the input to color and type
-        enum Color color;
-        enum Type type;
-        if (strcmp(input, "red") == 0) {
-            color = RED;
-        } else if (strcmp(input, "blue") == 0) {
-            color = BLUE;
-        } else if (strcmp(input, "green") == 0) {
-            color = GREEN;
-        } else if (strcmp(input, "yellow") == 0) {
-            color = YELLOW;
-        } else if (strcmp(input, "special") == 0) {
-            color = SPECIAL;
+        if (json) {
+            printf("]}%s\n", h + 1 < TELEMETRY_NUM_HISTOGRAMS ? "," : "");
         } else {
-            printf("Invalid input. Try again.\n");
-            continue; // Prompt the player to enter their choice again
+            printf("uno_%s_bucket{le=\"+Inf\"} %llu\nuno_%s_sum %llu\nuno_%s_count %llu\n",
+                   name, count, name, data->sums[h], name, count);
         }
+    }
+    if (json) {
+        printf("  }\n}\n");
+    }
+}
 
-        scanf("%s", input); // Read the type
-        for (int i = 0; input[i]; i++) {
-            input[i] = tolower(input[i]);
-        }
-        if (strcmp(input, "0") == 0) {
-            type = ZERO;
-        } else if (strcmp(input, "1") == 0) {
-            type = ONE;
-        } else if (strcmp(input, "2") == 0) {
-            type = TWO;
-        } else if (strcmp(input, "3") == 0) {
-            type = THREE;
-        } else if (strcmp(input, "4") == 0) {
-            type = FOUR;
-        } else if (strcmp(input, "5") == 0) {
-            type = FIVE;
-        } else if (strcmp(input, "6") == 0) {
-            type = SIX;
-        } else if (strcmp(input, "7") == 0) {
-            type = SEVEN;
-        } else if (strcmp(input, "8") == 0) {
-            type = EIGHT;
-        } else if (strcmp(input, "9") == 0) {
-            type = NINE;
-        } else if (strcmp(input, "skip") == 0) {
-            type = SKIP;
-        } else if (strcmp(input, "reverse") == 0) {
-            type = REVERSE;
-        } else if (strcmp(input, "draw") == 0) {
-            type = DRAW_TWO;
-        } else if (strcmp(input, "wild") == 0) {
-            type = WILD;
-        } else if (strcmp(input, "wilddraw") == 0) {
-            type = WILD_DRAW;
-        } else {
-            printf("Invalid input. Try again.\n");
-            continue; // Prompt the player to enter their choice again
+// Function to print the telemetry of the current thread (the games of an interactive session)
+void printThreadTelemetry(const char* format) {
+    printTelemetry(&telemetry, format);
+}
+#endif
+
+// Function to play complete games between bots on several threads and report the throughput
+void simulateGames(long numGames, int numPlayers, const enum StrategyKind* kinds, unsigned int rules,
+                   int numThreads, unsigned long long masterSeed, struct LogWriter* writer, bool batched) {
+    struct SimWorker* workers = (struct SimWorker*)calloc(numThreads, sizeof(struct SimWorker));
+    atomic_long nextGame = 0;
+
+    double start = getTime();
+    for (int i = 0; i < numThreads; i++) {
+        workers[i].numGames = numGames;
+        workers[i].numPlayers = numPlayers;
+        workers[i].kinds = kinds;
+        workers[i].rules = rules;
+        workers[i].masterSeed = masterSeed;
+        workers[i].nextGame = &nextGame;
+        workers[i].writer = writer;
+        workers[i].events = sessionEvents != NULL ? &sessionEvents->buses[i] : NULL;
+        workers[i].batched = batched;
+        pthread_create(&workers[i].thread, NULL, simulateWorker, &workers[i]);
+    }
+
+    // Merge the totals of all workers
+    struct SimStats total = { 0 };
+    for (int i = 0; i < numThreads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        total.games += workers[i].stats.games;
+        total.turns += workers[i].stats.turns;
+        total.unfinished += workers[i].stats.unfinished;
+        total.playouts += workers[i].stats.playouts;
+        for (int seat = 0; seat < numPlayers; seat++) {
+            total.wins[seat] += workers[i].stats.wins[seat];
         }
+        total.alloc.blocksAllocated += workers[i].stats.alloc.blocksAllocated;
+        total.alloc.blocksReleased += workers[i].stats.alloc.blocksReleased;
+        total.alloc.bytesInUse += workers[i].stats.alloc.bytesInUse;
+#ifdef UNO_TELEMETRY
+        mergeTelemetry(&total.telemetry, &workers[i].stats.telemetry);
+#endif
+    }
+    double elapsed = getTime() - start;
+    free(workers);
 
-        // Check if the chosen card is playable
-        struct Card* currentCard = (*currentPlayer)->hand;
-        int cardFound = 0; // Flag to track if the card is found in the player's hand
-        while (currentCard != NULL) {
-            if (currentCard->color == color && currentCard->type == type) {
-                cardFound = 1;
-                // Found the playable card
-                if (checkValidMove(*discardPile, currentCard)) {
-                    printf("Player %s played ", (*currentPlayer)->name);
-                    printCard(currentCard);
-                    printf("\n");
-                    // Remove played card from player's hand
-                    removeCardFromHand(*currentPlayer, currentCard);
-                    // Put currentcard on top of the deck
-                    if ((*discardPile)->type == WILD || (*discardPile)->type == WILD_DRAW) {
-                        (*discardPile)->color = SPECIAL;
-                    }
-                    (currentCard)->next = *discardPile;
-                    *discardPile = currentCard;
-                      switch ((*discardPile)->type) {
-
-                        case SKIP:
-SkipTurn(currentPlayer);
-
-                            // Skip the next player's turn
-                            break;
-                        case REVERSE:
-reverseDirection(*currentPlayer);
-   break;
-                        case WILD_DRAW:
-                            WildDraw(deck, (*currentPlayer)->next, *discardPile);
-                                          SkipTurn(currentPlayer);
-
-                            break;
-                        case DRAW_TWO:
-                            Draw_Two(deck, (*currentPlayer)->next);
-                            SkipTurn(currentPlayer);
-
-                            break;
-                        case WILD:
-                            Wild(*discardPile);
-                            break;
-                        default:
-                            break;;}
-                    return; // Player's turn completed
-                } else {
-                    printf("Invalid move. Try again.\n");
-                    break; // Prompt the player to enter the card details again
-                }
+    printf("Simulated %ld games with %d players on %d threads%s in %.3f s (%.0f games/s), seed %llu\n",
+           total.games, numPlayers, numThreads, batched ? " (batch engine)" : "", elapsed,
+           total.games / elapsed, masterSeed);
+    printf("Average turns per game: %.1f, games without a winner: %ld\n",
+           (double)total.turns / total.games, total.unfinished);
+    printf("Wins per seat:");
+    for (int seat = 0; seat < numPlayers; seat++) {
+        printf(" %ld (%s)", total.wins[seat], strategyNames[kinds[seat]]);
+    }
+    printf("\n");
+    if (total.playouts > 0) {
+        printf("Search playouts: %ld (%.0f/s)\n", total.playouts, total.playouts / elapsed);
+    }
+    printf("Arena blocks allocated: %ld, released: %ld, bytes still in use: %ld\n",
+           total.alloc.blocksAllocated, total.alloc.blocksReleased, total.alloc.bytesInUse);
+#ifdef UNO_TELEMETRY
+    if (telemetryFormat != NULL) {
+        printTelemetry(&total.telemetry, telemetryFormat);
+    }
+#endif
+}
+
+// Results of the benchmarks end up here, so the compiler cannot drop the work being measured
+static volatile unsigned long long benchSink;
+
+// Define the state shared by the micro benchmarks
+struct BenchContext {
+    struct Game* game;           // Four players, used for dealing and recycling
+    struct Deck shuffled;        // A shuffled full deck
+    unsigned char shuffledCards[DECK_SIZE];
+    struct Card faces[256];      // Random card faces for checkValidMove
+    unsigned char cards[256];    // Random card ids for the hand benchmarks
+    unsigned long long hands[256]; // Random hands of 7 cards for legalMoveMask
+    struct Deck laneDecks[SHUFFLE_LANES]; // Full decks for the batch shuffle kernel, with their generators
+    unsigned char laneCards[SHUFFLE_LANES][DECK_SIZE];
+    struct Rng laneRngs[SHUFFLE_LANES];
+    struct Game* copy;           // Copied over by copyGame
+    struct Move moves[MAX_MOVES]; // Legal moves of the game, made and taken back
+    int numMoves;
+    struct UndoLog undoLog;
+};
+
+// Benchmarked operations: each runs one operation and returns something that depends on it
+static unsigned long long benchInitializeDeck(struct BenchContext* context, long i) {
+    initializeDeck(&context->shuffled, 1);
+    return context->shuffled.cards[i % DECK_SIZE];
+}
+
+static unsigned long long benchShuffleDeck(struct BenchContext* context, long i) {
+    shuffleDeck(&context->shuffled, &context->game->rng);
+    return context->shuffled.cards[i % DECK_SIZE];
+}
+
+// Shuffles SHUFFLE_LANES decks at once
+static unsigned long long benchShuffleDecks(struct BenchContext* context, long i) {
+    shuffleDecks(context->laneDecks, context->laneRngs, SHUFFLE_LANES);
+    return context->laneCards[i % SHUFFLE_LANES][i % DECK_SIZE];
+}
+
+// Deals 7 cards to each of the 4 players from a full deck, resetting the deck and the hands first
+static unsigned long long benchDealCards(struct BenchContext* context, long i) {
+    struct Game* game = context->game;
+    (void)i;
+    memcpy(game->deck->cards, context->shuffled.cards, DECK_SIZE);
+    game->deck->count = DECK_SIZE;
+    for (int seat = 0; seat < game->numPlayers; seat++) {
+        memset(&game->seats[seat].hand, 0, sizeof(struct Hand));
+    }
+    dealCards(game->deck, &game->rng, game->seats, game->numPlayers, CARDS_PER_PLAYER);
+    return game->seats[0].hand.mask;
+}
+
+static unsigned long long benchCheckValidMove(struct BenchContext* context, long i) {
+    return checkValidMove(&context->faces[i & 255], &context->faces[(i + 1) & 255]);
+}
+
+// Finds every playable card of a hand
+static unsigned long long benchLegalMoveMask(struct BenchContext* context, long i) {
+    unsigned char top = context->cards[(i + 1) & 255];
+    enum Color color = cardColor(top) == SPECIAL ? (enum Color)(i & 3) : cardColor(top);
+    return legalMoveMask(context->hands[i & 255], top, color);
+}
+
+// Adds a card to a hand and removes it again
+static unsigned long long benchHandAddRemove(struct BenchContext* context, long i) {
+    struct Player* player = &context->game->seats[0];
+    unsigned char card = context->cards[i & 255];
+    addCardToHand(&player->hand, card);
+    removeCardFromHand(player, card);
+    return player->hand.mask;
+}
+
+static unsigned long long benchCopyGame(struct BenchContext* context, long i) {
+    copyGame(context->copy, context->game);
+    return context->copy->seats[i & 3].hand.size;
+}
+
+// Makes one of the legal moves, in turn, and takes it back
+static unsigned long long benchMakeUnmake(struct BenchContext* context, long i) {
+    struct Game* game = context->game;
+    struct Undo undo;
+    makeMove(game, &context->moves[i % context->numMoves], &context->undoLog, &undo);
+    unsigned long long size = game->currentPlayer->hand.size;
+    unmakeMove(game, &context->undoLog, &undo);
+    return size;
+}
+
+// Draws from an empty deck with the whole deck in the discard pile, so the pile is recycled
+static unsigned long long benchRecycle(struct BenchContext* context, long i) {
+    struct Game* game = context->game;
+    struct Player* player = &game->seats[0];
+    (void)i;
+    memcpy(game->discardPile->cards, context->shuffled.cards, DECK_SIZE);
+    game->discardPile->count = DECK_SIZE;
+    game->deck->count = 0;
+    int card = drawCard(game, player);
+    removeCardFromHand(player, card);
+    return card;
+}
+
+// Function to time one micro benchmark, doubling the number of operations until it runs long enough,
+// and print it as a JSON object
+static void runMicroBenchmark(const char* name, unsigned long long (*operation)(struct BenchContext*, long),
+                              struct BenchContext* context, bool last) {
+    long ops = 1024;
+    double elapsed;
+    while (1) {
+        unsigned long long sink = 0;
+        double start = getTime();
+        for (long i = 0; i < ops; i++) {
+            sink += operation(context, i);
+        }
+        elapsed = getTime() - start;
+        benchSink += sink;
+        if (elapsed >= BENCH_MIN_TIME) {
+            break;
+        }
+        ops *= 2;
+    }
+    printf("    {\"name\": \"%s\", \"ops\": %ld, \"ns_per_op\": %.2f}%s\n",
+           name, ops, elapsed * 1e9 / ops, last ? "" : ",");
+}
+
+// Function to time complete games between scripted players on one thread and print them as a JSON object
+static void runGameBenchmark(int numPlayers, bool last) {
+    enum StrategyKind kinds[MAX_PLAYERS];
+    for (int seat = 0; seat < numPlayers; seat++) {
+        kinds[seat] = STRATEGY_SCRIPTED;
+    }
+    struct Move moves[MAX_MOVES];
+    long games = 256;
+    struct SimStats stats;
+    struct AllocCounters before;
+    double elapsed;
+    while (1) {
+        memset(&stats, 0, sizeof(stats));
+        before = allocCounters;
+        double start = getTime();
+        for (long i = 0; i < games; i++) {
+            simulateGame(gameSeed(1, i), numPlayers, kinds, 0, moves, &stats, NULL, NULL);
+        }
+        elapsed = getTime() - start;
+        if (elapsed >= BENCH_MIN_TIME) {
+            break;
+        }
+        games *= 2;
+    }
+    long allocations = allocCounters.blocksAllocated - before.blocksAllocated;
+    printf("    {\"players\": %d, \"games\": %ld, \"games_per_s\": %.0f, \"ns_per_game\": %.0f, "
+           "\"turns_per_game\": %.1f, \"allocations_per_game\": %.2f, \"bytes_leaked\": %ld}%s\n",
+           numPlayers, games, games / elapsed, elapsed * 1e9 / games, (double)stats.turns / games,
+           (double)allocations / games, allocCounters.bytesInUse - before.bytesInUse, last ? "" : ",");
+}
+
+// Function to time the endgame solver on one thread and print the results as a JSON object. The positions
+// come from two-player games between scripted players, taken when a hand first drops to two cards
+// while neither hand holds more than eight.
+static void runSolverBenchmark(long maxNodes, bool last) {
+    static const char* names[] = { "Bot1", "Bot2" };
+    struct Move moves[MAX_MOVES];
+    int positions = 0;
+    int solved = 0;
+    long nodes = 0;
+    double elapsed = 0;
+    double solvedTime = 0;
+    for (long i = 0; positions < SOLVER_BENCH_POSITIONS; i++) {
+        struct Game* game = createGame(names, 2, false, gameSeed(1, i));
+        while (game->winner == NULL && (game->drawnCard >= 0
+               || (game->seats[0].hand.size > 2 && game->seats[1].hand.size > 2))) {
+            int numMoves = listLegalMoves(game, moves);
+            struct Move move = chooseScriptedMove(game, moves, numMoves);
+            applyMove(game, &move);
+        }
+        if (game->winner == NULL && game->seats[0].hand.size <= 8 && game->seats[1].hand.size <= 8) {
+            struct SolveResult result;
+            solveEndgame(game, SOLVER_DEFAULT_PLIES, maxNodes, 1, &result);
+            positions++;
+            nodes += result.nodes;
+            elapsed += result.seconds;
+            if (result.value != 0) {
+                solved++;
+                solvedTime += result.seconds;
             }
-            currentCard = currentCard->next;
         }
-        if (!cardFound) {
-            printf("You do not have that card in your hand!\n");
-            continue;
+        freeGame(game);
+    }
+    printf("    {\"max_nodes\": %ld, \"positions\": %d, \"solved\": %d, \"ms_per_position\": %.2f, "
+           "\"ms_per_solved\": %.2f, \"nodes_per_s\": %.0f}%s\n",
+           maxNodes, positions, solved, elapsed * 1e3 / positions, solved > 0 ? solvedTime * 1e3 / solved : 0.0,
+           nodes / elapsed, last ? "" : ",");
+}
+
+// Function to run every benchmark and print the results as JSON
+void runBenchmarks() {
+    static const char* names[] = { "Bot1", "Bot2", "Bot3", "Bot4" };
+    struct BenchContext context;
+    context.game = createGame(names, 4, false, 1);
+    context.shuffled.cards = context.shuffledCards;
+    initializeDeck(&context.shuffled, 1);
+    shuffleDeck(&context.shuffled, &context.game->rng);
+    for (int i = 0; i < 256; i++) {
+        unsigned char card = canonicalDeck[rngBounded(&context.game->rng, DECK_SIZE)];
+        context.cards[i] = card;
+        context.faces[i] = (struct Card){ cardColor(card), cardType(card) };
+        context.hands[i] = 0;
+        for (int j = 0; j < CARDS_PER_PLAYER; j++) {
+            context.hands[i] |= CARD_BIT(canonicalDeck[rngBounded(&context.game->rng, DECK_SIZE)]);
         }
     }
+
+    printf("{\n  \"micro\": [\n");
+    runMicroBenchmark("initializeDeck", benchInitializeDeck, &context, false);
+    runMicroBenchmark("shuffleDeck", benchShuffleDeck, &context, false);
+    for (int k = 0; k < SHUFFLE_LANES; k++) {
+        context.laneDecks[k].cards = context.laneCards[k];
+        initializeDeck(&context.laneDecks[k], 1);
+        rngSeed(&context.laneRngs[k], k);
+    }
+    pthread_once(&shuffleKernelOnce, selectShuffleKernel);
+    char shuffleName[64];
+    snprintf(shuffleName, sizeof(shuffleName), "shuffleDecks x%d (%s)", SHUFFLE_LANES, shuffleKernelName);
+    runMicroBenchmark(shuffleName, benchShuffleDecks, &context, false);
+    runMicroBenchmark("dealCards", benchDealCards, &context, false);
+    runMicroBenchmark("checkValidMove", benchCheckValidMove, &context, false);
+    runMicroBenchmark("legalMoveMask", benchLegalMoveMask, &context, false);
+    runMicroBenchmark("handAddRemove", benchHandAddRemove, &context, false);
+    context.copy = cloneGame(context.game);
+    context.numMoves = listLegalMoves(context.game, context.moves);
+    initUndoLog(&context.undoLog);
+    runMicroBenchmark("copyGame", benchCopyGame, &context, false);
+    runMicroBenchmark("makeUnmakeMove", benchMakeUnmake, &context, false);
+    freeUndoLog(&context.undoLog);
+    freeGame(context.copy);
+    runMicroBenchmark("recycleDiscardPile", benchRecycle, &context, true);
+    printf("  ],\n  \"games\": [\n");
+    runGameBenchmark(2, false);
+    runGameBenchmark(4, false);
+    runGameBenchmark(10, true);
+    printf("  ],\n  \"solver\": [\n");
+    runSolverBenchmark(10000, false);
+    runSolverBenchmark(100000, true);
+    printf("  ]\n}\n");
+    freeGame(context.game);
 }
 
-// Function to start the game
-void playGame() {
-    printf("Starting the game...\n");
+// Server protocol, one line per message, card ids and colors as numbers:
+//   client: JOIN <table> <seats> <name> [<rules>]   sit at a table, the game starts once all seats
+//                                                   are taken; rules as for --rules, the server's by default
+//           MOVE <index>                  play a move from the last YOURTURN list
+//           QUIT
+//   server: SEATED <table> <seat>
+//           START <table> <seats> <seed> <name>...
+//           HAND <card>...                        (to the player about to move)
+//           YOURTURN <turn> <top card> <active color> <moves> <move>...
+//                    moves are P<card>/<color>, D (draw) or S (keep the drawn card)
+//           MOVED <seat> P <card> <color> <turn> | MOVED <seat> D <turn> | MOVED <seat> S <turn>
+//           JUMPIN <seat> <card> <color>          (after MOVED, a player jumped in with the same card)
+//           SWAP <seat> <seat>                    (after MOVED, a 7 swapped the hands of the two seats)
+//           PASS <shift>                          (after MOVED, a 0 passed every hand <shift> seats on)
+//           DREW <card>                           (to the player who drew, before MOVED: one line per card
+//                                                 in the order drawn, the last one being the card a P
+//                                                 move may then play; a single DREW -1 when none was left)
+//           WIN <seat> | ABORT <table> | ERR <message>
 
- srand(time(NULL)); // Seed for random number generation
+// Define a client connection of the server
+struct Connection {
+    int fd;
+    char in[SERVER_LINE_SIZE];   // Bytes received, up to a full line
+    size_t inUsed;
+    char* out;                   // Bytes waiting to be sent
+    size_t outUsed;
+    size_t outSent;
+    size_t outCapacity;
+    struct Table* table;         // Table the client sits at, NULL when not seated
+    int seat;
+    bool waitingOut;             // Registered for EPOLLOUT because the socket was full
+    bool dirty;                  // In the list of connections to flush
+    bool closing;                // In the list of connections to close
+    struct ServerLoop* handoff;  // Loop taking the connection over, NULL when staying
+    struct Connection* nextDirty;
+    struct Connection* nextClosed;
+    struct Connection* nextHandoff;
+};
+
+// Define a table: its seats and, once everybody sat down, its game
+struct Table {
+    long id;
+    int numSeats;
+    int numJoined;
+    unsigned int rules;          // House rules, set by the first player to join
+    struct Connection* seats[MAX_PLAYERS];
+    char* names[MAX_PLAYERS];    // Names of the players seated, as long as they were sent
+    struct Game* game;
+    struct Table* next;          // Next table in the same hash bucket
+};
 
+// Define an event loop of the server. Tables belong to the loop given by their id, connections move
+// to the loop of the table they join, so a game is only ever touched by one thread.
+struct ServerLoop {
+    pthread_t thread;
+    struct Server* server;
+    int epoll;
+    int wakeup;                  // eventfd signalled when connections are handed over
+    pthread_mutex_t handoffLock;
+    struct Connection* handoffs; // Connections handed over by other loops
+    struct Connection* dirty;    // Connections with output to send at the end of the iteration
+    struct Connection* closed;   // Connections to close at the end of the iteration
+    struct Connection* leaving;  // Connections to hand over at the end of the iteration
+    struct Table* tables[SERVER_TABLE_BUCKETS];
+    struct Move moves[MAX_MOVES];
+    struct UndoLog journal;      // Changes made by the last move played
+};
 
+// Define the server
+struct Server {
+    int listener;
+    int numLoops;
+    struct ServerLoop* loops;
+    unsigned long long seed;
+    unsigned int rules;          // House rules of tables joined without rules
+    atomic_long nextGame;        // Index of the next game started, seeds it like a simulated game
+    atomic_long gamesFinished;
+    atomic_long movesPlayed;
+};
 
-    struct Card* deck = NULL;
-    initializeDeck(&deck);
-    shuffleDeck(&deck);
-   // printDeck(deck);
-       char a[100]; // Buffer to clear input
+// Tags telling the listening socket and the wakeup eventfd from connections in epoll events
+static int listenerTag;
+static int wakeupTag;
+static volatile sig_atomic_t serverStopping = 0;
 
-    int numPlayers;
+// Signal handler asking the event loops to stop
+static void stopServer(int signal) {
+    (void)signal;
+    serverStopping = 1;
+}
 
-        do {
-        printf("Enter number of players (between 2 and 10): ");
-        if (scanf("%d", &numPlayers) != 1) {
-            printf("Invalid input. Please enter a valid number.\n");
-            scanf("%s", a); // Clear input buffer
-            continue; // Continue to next iteration
+// Function to allow as many open files as the hard limit, the server and the load test need one per client
+static void raiseFileLimit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// Function to open a listening or connected socket for a Unix socket path (anything with a '/')
+// or [HOST:]PORT over TCP, on 127.0.0.1 unless a host is given. Returns -1 on error.
+static int openSocket(const char* address, bool listening) {
+    int fd;
+    if (strchr(address, '/') != NULL) {
+        struct sockaddr_un local = { .sun_family = AF_UNIX };
+        if (strlen(address) >= sizeof(local.sun_path) || (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+            return -1;
+        }
+        strcpy(local.sun_path, address);
+        if (listening) {
+            unlink(address);
+        }
+        if (listening ? bind(fd, (struct sockaddr*)&local, sizeof(local)) != 0 || listen(fd, SERVER_BACKLOG) != 0
+                      : connect(fd, (struct sockaddr*)&local, sizeof(local)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    char host[64] = "127.0.0.1";
+    const char* port = strrchr(address, ':');
+    if (port != NULL) {
+        size_t length = port - address;
+        if (length >= sizeof(host)) {
+            return -1;
+        }
+        memcpy(host, address, length);
+        host[length] = '\0';
+        port++;
+    } else {
+        port = address;
+    }
+    struct sockaddr_in inet = { .sin_family = AF_INET, .sin_port = htons(atoi(port)) };
+    if (inet_pton(AF_INET, host, &inet.sin_addr) != 1 || (fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (listening) {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (listening ? bind(fd, (struct sockaddr*)&inet, sizeof(inet)) != 0 || listen(fd, SERVER_BACKLOG) != 0
+                  : connect(fd, (struct sockaddr*)&inet, sizeof(inet)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Function to queue text for a connection, it is sent at the end of the loop iteration
+static void sendText(struct ServerLoop* loop, struct Connection* conn, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+static void sendText(struct ServerLoop* loop, struct Connection* conn, const char* format, ...) {
+    if (conn->closing) {
+        return;
+    }
+    while (1) {
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(conn->out + conn->outUsed, conn->outCapacity - conn->outUsed, format, args);
+        va_end(args);
+        if (conn->out != NULL && conn->outUsed + length < conn->outCapacity) {
+            conn->outUsed += length;
+            break;
         }
+        conn->outCapacity = conn->outCapacity == 0 ? 256 : 2 * conn->outCapacity;
+        conn->out = (char*)realloc(conn->out, conn->outCapacity);
+    }
+    if (!conn->dirty) {
+        conn->dirty = true;
+        conn->nextDirty = loop->dirty;
+        loop->dirty = conn;
+    }
+}
 
-        if (numPlayers < 2 || numPlayers > 10) {
-            printf("Invalid number of players. Please enter a number between 2 and 10.\n");
+// Function to get the hash bucket of a table id
+static struct Table** tableBucket(struct ServerLoop* loop, long id) {
+    return &loop->tables[((unsigned long long)id * 0x9E3779B97F4A7C15ULL) >> 52 & (SERVER_TABLE_BUCKETS - 1)];
+}
+
+// Function to remove a table and unseat its players, telling them why when there is a message
+static void closeTable(struct ServerLoop* loop, struct Table* table, const char* message) {
+    for (int seat = 0; seat < table->numSeats; seat++) {
+        struct Connection* conn = table->seats[seat];
+        if (conn != NULL) {
+            conn->table = NULL;
+            if (message != NULL) {
+                sendText(loop, conn, "%s %ld\n", message, table->id);
+            }
         }
-    } while (numPlayers < 2 || numPlayers > 10);
+    }
+    if (table->game != NULL) {
+        freeGame(table->game);
+    }
+    for (int seat = 0; seat < table->numJoined; seat++) {
+        free(table->names[seat]);
+    }
+    struct Table** link = tableBucket(loop, table->id);
+    while (*link != table) {
+        link = &(*link)->next;
+    }
+    *link = table->next;
+    free(table);
+}
+
+// Function to close a connection at the end of the loop iteration; the game at its table is abandoned
+static void dropConnection(struct ServerLoop* loop, struct Connection* conn) {
+    if (conn->closing) {
+        return;
+    }
+    if (conn->table != NULL) {
+        struct Table* table = conn->table;
+        table->seats[conn->seat] = NULL;
+        closeTable(loop, table, "ABORT");
+    }
+    conn->closing = true;
+    conn->nextClosed = loop->closed;
+    loop->closed = conn;
+}
 
+// Function to tell the player to move what they hold and which moves they have
+static void sendTurn(struct ServerLoop* loop, struct Table* table) {
+    struct Game* game = table->game;
+    struct Player* player = game->currentPlayer;
+    struct Connection* conn = table->seats[player->seat];
+    sendText(loop, conn, "HAND");
+    for (unsigned long long mask = player->hand.mask; mask != 0; mask &= mask - 1) {
+        unsigned char card = __builtin_ctzll(mask);
+        for (int i = 0; i < player->hand.counts[card]; i++) {
+            sendText(loop, conn, " %d", card);
+        }
+    }
+    int numMoves = listLegalMoves(game, loop->moves);
+    sendText(loop, conn, "\nYOURTURN %d %d %d %d", game->turns,
+             game->discardPile->cards[game->discardPile->count - 1], game->activeColor, numMoves);
+    for (int i = 0; i < numMoves; i++) {
+        const struct Move* move = &loop->moves[i];
+        if (move->kind == MOVE_PLAY) {
+            sendText(loop, conn, " P%d/%d", move->card, move->color);
+        } else {
+            sendText(loop, conn, move->kind == MOVE_DRAW ? " D" : " S");
+        }
+    }
+    sendText(loop, conn, "\n");
+}
 
+// Function to seat a client at a table, starting the game when the table is full
+static void joinTable(struct ServerLoop* loop, struct Connection* conn, long id, int numSeats, const char* name,
+                      int nameLength, unsigned int rules) {
+    struct Table** bucket = tableBucket(loop, id);
+    struct Table* table = *bucket;
+    while (table != NULL && table->id != id) {
+        table = table->next;
+    }
+    if (table == NULL) {
+        table = (struct Table*)calloc(1, sizeof(struct Table));
+        table->id = id;
+        table->numSeats = numSeats;
+        table->rules = rules;
+        table->next = *bucket;
+        *bucket = table;
+    }
+    if (table->game != NULL || table->numSeats != numSeats || table->rules != rules) {
+        sendText(loop, conn, "ERR table %ld is not open for %d players with these rules\n", id, numSeats);
+        return;
+    }
+    int seat = table->numJoined++;
+    table->seats[seat] = conn;
+    table->names[seat] = strndup(name, nameLength);
+    conn->table = table;
+    conn->seat = seat;
+    sendText(loop, conn, "SEATED %ld %d\n", id, seat);
+    if (table->numJoined < table->numSeats) {
+        return;
+    }
 
+    const char* names[MAX_PLAYERS];
+    for (int i = 0; i < numSeats; i++) {
+        names[i] = table->names[i];
+    }
+    unsigned long long seed = gameSeed(loop->server->seed, atomic_fetch_add(&loop->server->nextGame, 1));
+    table->game = createGame(names, numSeats, false, seed);
+    table->game->rules = rules;
+    for (int i = 0; i < numSeats; i++) {
+        sendText(loop, table->seats[i], "START %ld %d %llu", id, numSeats, seed);
+        for (int j = 0; j < numSeats; j++) {
+            sendText(loop, table->seats[i], " %s", names[j]);
+        }
+        sendText(loop, table->seats[i], "\n");
+    }
+    sendTurn(loop, table);
+}
 
-    struct Player* firstPlayer = NULL;
-    for (int i = 0; i < numPlayers; i++) {
-        char playerName[20];
-        printf("Enter player %d's name: ", i + 1);
-        scanf("%s", playerName);
-        struct Player* newPlayer = createPlayer(playerName);
-        addPlayerToList(&firstPlayer, newPlayer);
+// Function to apply a move sent by a client and tell the whole table
+static void playMove(struct ServerLoop* loop, struct Connection* conn, int index) {
+    struct Table* table = conn->table;
+    struct Game* game = table == NULL ? NULL : table->game;
+    if (game == NULL || game->currentPlayer->seat != conn->seat) {
+        sendText(loop, conn, "ERR not your turn\n");
+        return;
     }
+    int numMoves = listLegalMoves(game, loop->moves);
+    if (index < 0 || index >= numMoves) {
+        sendText(loop, conn, "ERR no move %d\n", index);
+        return;
+    }
+    // The journal of the move tells every card it drew and what the engine did for other seats
+    struct Move move = loop->moves[index];
+    struct Undo undo;
+    loop->journal.numChanges = 0;
+    makeMove(game, &move, &loop->journal, &undo);
+    atomic_fetch_add(&loop->server->movesPlayed, 1);
+
+    if (move.kind == MOVE_DRAW) {
+        // Only the player who drew sees the cards, in the order drawn
+        bool drew = false;
+        for (int i = 0; i < loop->journal.numChanges; i++) {
+            if (loop->journal.changes[i].kind == CHANGE_DRAW) {
+                sendText(loop, conn, "DREW %d\n", loop->journal.changes[i].card);
+                drew = true;
+            }
+        }
+        if (!drew) {
+            sendText(loop, conn, "DREW -1\n");
+        }
+    }
+    for (int seat = 0; seat < table->numSeats; seat++) {
+        struct Connection* other = table->seats[seat];
+        if (move.kind == MOVE_PLAY) {
+            sendText(loop, other, "MOVED %d P %d %d %d\n", conn->seat, move.card, move.color, game->turns);
+        } else {
+            sendText(loop, other, "MOVED %d %c %d\n", conn->seat, move.kind == MOVE_DRAW ? 'D' : 'S', game->turns);
+        }
+        // Plays and hand swaps the engine made after the move itself, in order
+        bool moverPlayed = move.kind != MOVE_PLAY;
+        for (int i = 0; i < loop->journal.numChanges; i++) {
+            const struct Change* change = &loop->journal.changes[i];
+            if (change->kind == CHANGE_PLAY && !moverPlayed) {
+                moverPlayed = true;
+            } else if (change->kind == CHANGE_PLAY) {
+                sendText(loop, other, "JUMPIN %d %d %d\n", change->seat, change->card, move.color);
+            } else if (change->kind == CHANGE_SWAP) {
+                sendText(loop, other, "SWAP %d %d\n", change->seat, change->slot);
+            } else if (change->kind == CHANGE_PASS) {
+                sendText(loop, other, "PASS %d\n", change->slot);
+            }
+        }
+    }
+    if (getWinner(game) != NULL) {
+        for (int seat = 0; seat < table->numSeats; seat++) {
+            sendText(loop, table->seats[seat], "WIN %d\n", getWinner(game)->seat);
+        }
+        atomic_fetch_add(&loop->server->gamesFinished, 1);
+        closeTable(loop, table, NULL);
+        return;
+    }
+    sendTurn(loop, table);
+}
 
-    dealCards(&deck, firstPlayer, numPlayers, 7);
-    // Setting up the initial discard pile
-struct Card* topCard = deck;
-deck = deck->next; // Move to the next card in the deck
+// Function to handle one line from a client. Returns false when the connection must first move to
+// the loop that owns the table it joins; the line is then handled again by that loop.
+static bool handleLine(struct ServerLoop* loop, struct Connection* conn, char* line) {
+    long id;
+    int numSeats;
+    int index;
+    int nameStart = 0;
+    int nameEnd = 0;
+    char ruleList[100];
+    // The name is the whole third field, whatever its length; the line is left as it is, it may be
+    // handled again by another loop
+    sscanf(line, "JOIN %ld %d %n%*s%n", &id, &numSeats, &nameStart, &nameEnd);
+    if (nameEnd > nameStart) {
+        int numRules = sscanf(line + nameEnd, "%99s", ruleList);
+        unsigned int rules = loop->server->rules;
+        if (conn->table != NULL) {
+            sendText(loop, conn, "ERR already seated at table %ld\n", conn->table->id);
+        } else if (id < 0 || numSeats < 2 || numSeats > MAX_PLAYERS) {
+            sendText(loop, conn, "ERR a table needs an id and 2 to %d seats\n", MAX_PLAYERS);
+        } else if (numRules == 1 && !parseRules(ruleList, &rules)) {
+            sendText(loop, conn, "ERR unknown rules %s\n", ruleList);
+        } else {
+            struct ServerLoop* owner = &loop->server->loops[id % loop->server->numLoops];
+            if (owner != loop) {
+                conn->handoff = owner;
+                conn->nextHandoff = loop->leaving;
+                loop->leaving = conn;
+                return false;
+            }
+            joinTable(loop, conn, id, numSeats, line + nameStart, nameEnd - nameStart, rules);
+        }
+    } else if (sscanf(line, "MOVE %d", &index) == 1) {
+        playMove(loop, conn, index);
+    } else if (strcmp(line, "QUIT") == 0) {
+        dropConnection(loop, conn);
+    } else {
+        sendText(loop, conn, "ERR unknown command\n");
+    }
+    return true;
+}
 
-// Check if the top card is a Wild or Special card
-while (topCard->color == SPECIAL || topCard->type == DRAW_TWO || topCard->type ==  REVERSE || topCard->type ==  SKIP  ) {
-    // If it's a Wild or Special card, put it back in the deck and move to the next card
-    topCard->next = deck;
-    deck = topCard;
-    topCard = topCard->next;
+// Function to handle the complete lines a client sent
+static void processInput(struct ServerLoop* loop, struct Connection* conn) {
+    size_t start = 0;
+    while (!conn->closing && conn->handoff == NULL) {
+        char* end = memchr(conn->in + start, '\n', conn->inUsed - start);
+        if (end == NULL) {
+            break;
+        }
+        *end = '\0';
+        if (end > conn->in + start && end[-1] == '\r') {
+            end[-1] = '\0';
+        }
+        if (!handleLine(loop, conn, conn->in + start)) {
+            *end = '\n';
+            break;
+        }
+        start = end + 1 - conn->in;
+    }
+    memmove(conn->in, conn->in + start, conn->inUsed - start);
+    conn->inUsed -= start;
 }
 
-// Initialize the discard pile with the non-Wild, non-Special top card from the deck
-struct Card* discardPile = topCard;
-discardPile->next = NULL; // Ensure the discard pile starts as a single card
+// Function to read what a client sent
+static void readConnection(struct ServerLoop* loop, struct Connection* conn) {
+    while (!conn->closing && conn->handoff == NULL) {
+        if (conn->inUsed == SERVER_LINE_SIZE) {
+            sendText(loop, conn, "ERR line too long\n");
+            dropConnection(loop, conn);
+            return;
+        }
+        ssize_t received = recv(conn->fd, conn->in + conn->inUsed, SERVER_LINE_SIZE - conn->inUsed, 0);
+        if (received > 0) {
+            conn->inUsed += received;
+            processInput(loop, conn);
+        } else if (received == 0 || (errno != EAGAIN && errno != EINTR)) {
+            dropConnection(loop, conn);
+        } else if (errno == EAGAIN) {
+            return;
+        }
+    }
+}
 
-    printf("\nGame Started\n");
+// Function to send what is queued for a client, waiting for EPOLLOUT when the socket is full
+static void flushConnection(struct ServerLoop* loop, struct Connection* conn) {
+    while (conn->outSent < conn->outUsed) {
+        ssize_t sent = send(conn->fd, conn->out + conn->outSent, conn->outUsed - conn->outSent, MSG_NOSIGNAL);
+        if (sent > 0) {
+            conn->outSent += sent;
+        } else if (errno == EAGAIN) {
+            if (!conn->waitingOut) {
+                struct epoll_event event = { EPOLLIN | EPOLLOUT, { .ptr = conn } };
+                epoll_ctl(loop->epoll, EPOLL_CTL_MOD, conn->fd, &event);
+                conn->waitingOut = true;
+            }
+            return;
+        } else if (errno != EINTR) {
+            dropConnection(loop, conn);
+            return;
+        }
+    }
+    conn->outUsed = 0;
+    conn->outSent = 0;
+    if (conn->waitingOut) {
+        struct epoll_event event = { EPOLLIN, { .ptr = conn } };
+        epoll_ctl(loop->epoll, EPOLL_CTL_MOD, conn->fd, &event);
+        conn->waitingOut = false;
+    }
+}
 
-    struct Player* currentPlayer = firstPlayer;
+// Function to accept every pending client
+static void acceptConnections(struct ServerLoop* loop) {
     while (1) {
-playTurn(&deck, &currentPlayer, &discardPile);
-
-// Check if the current player's hand is empty
-        if (currentPlayer->hand == NULL) {
-            printf("Player %s wins the game!\n", currentPlayer->name);
-                    // Free dynamically allocated memory
-                if (deck != NULL) {
-                    freeDeck(deck);  // Free the deck
-                    deck = NULL;     // Set deck pointer to NULL after freeing
+        int fd = accept4(loop->server->listener, NULL, NULL, SOCK_NONBLOCK);
+        if (fd < 0) {
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct Connection* conn = (struct Connection*)calloc(1, sizeof(struct Connection));
+        conn->fd = fd;
+        struct epoll_event event = { EPOLLIN, { .ptr = conn } };
+        epoll_ctl(loop->epoll, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+// Function to take over the connections other loops handed to this one
+static void adoptConnections(struct ServerLoop* loop) {
+    unsigned long long count;
+    if (read(loop->wakeup, &count, sizeof(count)) != sizeof(count)) {
+        return;
+    }
+    pthread_mutex_lock(&loop->handoffLock);
+    struct Connection* conn = loop->handoffs;
+    loop->handoffs = NULL;
+    pthread_mutex_unlock(&loop->handoffLock);
+    while (conn != NULL) {
+        struct Connection* next = conn->nextHandoff;
+        conn->handoff = NULL;
+        conn->waitingOut = conn->outSent < conn->outUsed;
+        struct epoll_event event = { conn->waitingOut ? EPOLLIN | EPOLLOUT : EPOLLIN, { .ptr = conn } };
+        epoll_ctl(loop->epoll, EPOLL_CTL_ADD, conn->fd, &event);
+        processInput(loop, conn);
+        conn = next;
+    }
+}
+
+// Function to finish a loop iteration: send the queued output, hand connections over, close the dropped ones
+static void finishIteration(struct ServerLoop* loop) {
+    while (loop->dirty != NULL) {
+        struct Connection* conn = loop->dirty;
+        loop->dirty = conn->nextDirty;
+        conn->dirty = false;
+        if (!conn->closing) {
+            flushConnection(loop, conn);
+        }
+    }
+    while (loop->leaving != NULL) {
+        struct Connection* conn = loop->leaving;
+        loop->leaving = conn->nextHandoff;
+        if (conn->closing) {
+            continue;
+        }
+        struct ServerLoop* owner = conn->handoff;
+        epoll_ctl(loop->epoll, EPOLL_CTL_DEL, conn->fd, NULL);
+        pthread_mutex_lock(&owner->handoffLock);
+        conn->nextHandoff = owner->handoffs;
+        owner->handoffs = conn;
+        pthread_mutex_unlock(&owner->handoffLock);
+        unsigned long long one = 1;
+        if (write(owner->wakeup, &one, sizeof(one)) != sizeof(one)) {
+            perror("eventfd");
+        }
+    }
+    while (loop->closed != NULL) {
+        struct Connection* conn = loop->closed;
+        loop->closed = conn->nextClosed;
+        close(conn->fd);
+        free(conn->out);
+        free(conn);
+    }
+}
+
+// Function run by each event loop thread
+static void* serverLoop(void* arg) {
+    struct ServerLoop* loop = (struct ServerLoop*)arg;
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    while (!serverStopping) {
+        int numEvents = epoll_wait(loop->epoll, events, SERVER_MAX_EVENTS, 200);
+        for (int i = 0; i < numEvents; i++) {
+            void* tag = events[i].data.ptr;
+            if (tag == &listenerTag) {
+                acceptConnections(loop);
+            } else if (tag == &wakeupTag) {
+                adoptConnections(loop);
+            } else {
+                struct Connection* conn = (struct Connection*)tag;
+                if (conn->closing || conn->handoff != NULL) {
+                    continue;
                 }
-                if (firstPlayer != NULL) {
-                    freePlayerList(firstPlayer);  // Free the player list
-                    firstPlayer = NULL;            // Set player list pointer to NULL after freeing
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    readConnection(loop, conn);
                 }
-            break; // End the game
+                if ((events[i].events & EPOLLOUT) && !conn->closing && !conn->dirty) {
+                    flushConnection(loop, conn);
+                }
+            }
+        }
+        finishIteration(loop);
+    }
+    return NULL;
+}
+
+// Function to serve tables until interrupted, with one event loop per thread
+int runServer(const char* address, int numLoops, unsigned long long seed, unsigned int rules) {
+    raiseFileLimit();
+    struct Server server;
+    server.listener = openSocket(address, true);
+    if (server.listener < 0) {
+        fprintf(stderr, "Could not listen on %s: %s\n", address, strerror(errno));
+        return 1;
+    }
+    fcntl(server.listener, F_SETFL, O_NONBLOCK);
+    server.numLoops = numLoops;
+    server.seed = seed;
+    server.rules = rules;
+    atomic_init(&server.nextGame, 0);
+    atomic_init(&server.gamesFinished, 0);
+    atomic_init(&server.movesPlayed, 0);
+    server.loops = (struct ServerLoop*)calloc(numLoops, sizeof(struct ServerLoop));
+
+    struct sigaction action = { 0 };
+    action.sa_handler = stopServer;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    for (int i = 0; i < numLoops; i++) {
+        struct ServerLoop* loop = &server.loops[i];
+        loop->server = &server;
+        loop->epoll = epoll_create1(0);
+        loop->wakeup = eventfd(0, EFD_NONBLOCK);
+        pthread_mutex_init(&loop->handoffLock, NULL);
+        initUndoLog(&loop->journal);
+        // Every loop accepts, EPOLLEXCLUSIVE wakes only one of them per new client
+        struct epoll_event listenEvent = { EPOLLIN | EPOLLEXCLUSIVE, { .ptr = &listenerTag } };
+        epoll_ctl(loop->epoll, EPOLL_CTL_ADD, server.listener, &listenEvent);
+        struct epoll_event wakeupEvent = { EPOLLIN, { .ptr = &wakeupTag } };
+        epoll_ctl(loop->epoll, EPOLL_CTL_ADD, loop->wakeup, &wakeupEvent);
+    }
+    printf("Serving Uno tables on %s with %d event loops, seed %llu\n", address, numLoops, seed);
+    fflush(stdout);
+    for (int i = 0; i < numLoops; i++) {
+        pthread_create(&server.loops[i].thread, NULL, serverLoop, &server.loops[i]);
+    }
+    for (int i = 0; i < numLoops; i++) {
+        pthread_join(server.loops[i].thread, NULL);
+    }
+    printf("Stopped after %ld games started, %ld finished, %ld moves\n", atomic_load(&server.nextGame),
+           atomic_load(&server.gamesFinished), atomic_load(&server.movesPlayed));
+    fflush(stdout);
+    // The process exits right after, open connections are left to the system
+    for (int i = 0; i < numLoops; i++) {
+        struct ServerLoop* loop = &server.loops[i];
+        for (int bucket = 0; bucket < SERVER_TABLE_BUCKETS; bucket++) {
+            while (loop->tables[bucket] != NULL) {
+                closeTable(loop, loop->tables[bucket], NULL);
+            }
         }
-    currentPlayer = currentPlayer->next; // Move to the next player
-   // clearScreen() ;
+        close(loop->epoll);
+        close(loop->wakeup);
+        pthread_mutex_destroy(&loop->handoffLock);
+        freeUndoLog(&loop->journal);
+    }
+    free(server.loops);
+    close(server.listener);
+    if (strchr(address, '/') != NULL) {
+        unlink(address);
+    }
+    return 0;
+}
+
+// Define a connection of the load test, playing the first legal move every turn
+struct LoadClient {
+    int fd;
+    int index;
+    int seat;
+    int round;                   // Games finished so far
+    char in[SERVER_LINE_SIZE];
+    size_t inUsed;
+};
 
+// Function to send a line from the load test, the lines are short enough to never fill a socket
+static void sendLoadLine(struct LoadClient* client, const char* line) {
+    size_t length = strlen(line);
+    if (send(client->fd, line, length, MSG_NOSIGNAL) != (ssize_t)length) {
+        fprintf(stderr, "Load test client %d could not send: %s\n", client->index, strerror(errno));
+        exit(1);
     }
+}
+
+// Function to sort latencies
+static int compareFloats(const void* a, const void* b) {
+    float x = *(const float*)a;
+    float y = *(const float*)b;
+    return (x > y) - (x < y);
+}
 
+// Function to run a load test against a server: every group of players sits at a table and plays
+// the given number of games with the first legal move. The latency measured is from sending a move
+// to each player of the table receiving it.
+int runLoadTest(const char* address, int numConnections, int numPlayers, int numGames) {
+    raiseFileLimit();
+    int numTables = numConnections / numPlayers;
+    numConnections = numTables * numPlayers;
+    struct LoadClient* clients = (struct LoadClient*)calloc(numConnections, sizeof(struct LoadClient));
+    double* moveSent = (double*)calloc(numTables, sizeof(double));
+    size_t numSamples = 0;
+    size_t sampleCapacity = 1 << 20;
+    float* samples = (float*)malloc(sampleCapacity * sizeof(float));
+    long baseId = (long)getpid() * 1000000000L;
+    int epoll = epoll_create1(0);
+    char line[64];
 
+    for (int i = 0; i < numConnections; i++) {
+        struct LoadClient* client = &clients[i];
+        client->index = i;
+        client->fd = openSocket(address, false);
+        if (client->fd < 0) {
+            fprintf(stderr, "Connection %d to %s failed: %s\n", i, address, strerror(errno));
+            return 1;
+        }
+        fcntl(client->fd, F_SETFL, O_NONBLOCK);
+        struct epoll_event event = { EPOLLIN, { .ptr = client } };
+        epoll_ctl(epoll, EPOLL_CTL_ADD, client->fd, &event);
+    }
+    double start = getTime();
+    for (int i = 0; i < numConnections; i++) {
+        snprintf(line, sizeof(line), "JOIN %ld %d c%d\n", baseId + i / numPlayers, numPlayers, i);
+        sendLoadLine(&clients[i], line);
+    }
+
+    long gamesDone = 0;
+    long moves = 0;
+    int finished = 0;
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    while (finished < numConnections) {
+        int numEvents = epoll_wait(epoll, events, SERVER_MAX_EVENTS, 10000);
+        if (numEvents <= 0) {
+            fprintf(stderr, "Load test stalled with %d of %d connections done.\n", finished, numConnections);
+            return 1;
+        }
+        for (int e = 0; e < numEvents; e++) {
+            struct LoadClient* client = (struct LoadClient*)events[e].data.ptr;
+            int table = client->index / numPlayers;
+            ssize_t received = recv(client->fd, client->in + client->inUsed, SERVER_LINE_SIZE - client->inUsed, 0);
+            if (received <= 0) {
+                if (received < 0 && errno == EAGAIN) {
+                    continue;
+                }
+                fprintf(stderr, "Server closed connection %d.\n", client->index);
+                return 1;
+            }
+            client->inUsed += received;
+            double now = getTime();
+            char* text = client->in;
+            char* end;
+            while ((end = memchr(text, '\n', client->in + client->inUsed - text)) != NULL) {
+                *end = '\0';
+                if (strncmp(text, "SEATED ", 7) == 0) {
+                    sscanf(text, "SEATED %*d %d", &client->seat);
+                } else if (strncmp(text, "YOURTURN ", 9) == 0) {
+                    moveSent[table] = getTime();
+                    sendLoadLine(client, "MOVE 0\n");
+                } else if (strncmp(text, "MOVED ", 6) == 0) {
+                    if (numSamples == sampleCapacity) {
+                        sampleCapacity *= 2;
+                        samples = (float*)realloc(samples, sampleCapacity * sizeof(float));
+                    }
+                    samples[numSamples++] = (float)((now - moveSent[table]) * 1e6);
+                    moves += client->seat == 0;
+                } else if (strncmp(text, "WIN ", 4) == 0) {
+                    gamesDone += client->seat == 0;
+                    if (++client->round == numGames) {
+                        finished++;
+                    } else {
+                        snprintf(line, sizeof(line), "JOIN %ld %d c%d\n",
+                                 baseId + (long)client->round * numTables + table, numPlayers, client->index);
+                        sendLoadLine(client, line);
+                    }
+                } else if (strncmp(text, "ABORT ", 6) == 0 || strncmp(text, "ERR ", 4) == 0) {
+                    fprintf(stderr, "Connection %d: %s\n", client->index, text);
+                    return 1;
+                }
+                text = end + 1;
+            }
+            client->inUsed -= text - client->in;
+            memmove(client->in, text, client->inUsed);
+        }
+    }
+    double elapsed = getTime() - start;
 
-    return ;
+    qsort(samples, numSamples, sizeof(float), compareFloats);
+    printf("Load test: %d connections at %d tables, %ld games, %ld moves in %.2f s (%.0f moves/s)\n",
+           numConnections, numTables, gamesDone, moves, elapsed, moves / elapsed);
+    if (numSamples > 0) {
+        printf("Move to broadcast latency: p50 %.0f us, p90 %.0f us, p99 %.0f us, max %.0f us\n",
+               samples[numSamples / 2], samples[numSamples * 9 / 10], samples[numSamples * 99 / 100],
+               samples[numSamples - 1]);
+    }
+    for (int i = 0; i < numConnections; i++) {
+        close(clients[i].fd);
+    }
+    close(epoll);
+    free(samples);
+    free(moveSent);
+    free(clients);
+    return 0;
 }
 
 // Function to display game instructions
@@ -778,9 +6204,10 @@ void displayInstructions() {
     printf("1. The goal of the game is to be the first player to get rid of all your cards.\n");
     printf("2. Players take turns playing a card from their hand that matches the top card or draw a card.\n");
     printf("3. If a player cannot play a card or Do Not Want to, they must draw a card from the deck.\n");
-    printf("4. Normal cards are played by typing the cards color followed by its number in digit (eg : red 4 ) .\n");
-    printf("5. Other special but colored cards Color function Draw for draw two Skip/Reverse for skip/reverse .\n");
-    printf("6. For special cards : special wild / special wilddraw .\n ");
+    printf("4. Normal cards are played by typing the cards color followed by its number in digit (eg : �red 4� ) .\n");
+    printf("5. Other special but colored cards �Color function� �Draw� for draw two �Skip/Reverse� for skip/reverse .\n");
+    printf("6. For special cards : �special wild� / �special wilddraw� .\n ");
+    printf("7. Type 'hint' to see how likely the other players are to hold each color, from what they played and drew.\n");
 
 
 }